@@ -37,7 +37,7 @@ int main(int argc, char** argv)
   simulation_space::mc annealing {mc_params_file};
   annealing.print_mc_parameters();
 
-  annealing.t_scan(new_model);
+  annealing.run(new_model);
 
   return 0;
 }
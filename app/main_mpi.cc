@@ -0,0 +1,45 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include <iostream>
+#include <mpi.h>
+#include <CLI11.hpp>
+
+#include "mpi_domain.h"
+
+int main(int argc, char** argv)
+{
+  MPI_Init(&argc, &argv);
+
+  // Define the command-line arguments we can parse
+  CLI::App app{"Performs a Monte-Carlo simulated annealing on a lattice "
+               "decomposed over MPI ranks."};
+  argv = app.ensure_utf8(argv);
+
+  std::string model_params_file = "input/model_params.json";
+  app.add_option("-m,--model-params",
+                 model_params_file,
+                 "JSON input file for model parameters");
+
+  std::string mc_params_file = "input/mc_params.json";
+  app.add_option("-M,--mc-params",
+                 mc_params_file,
+                 "JSON input file for Monte-Carlo annealing parameters");
+
+  try {
+    app.parse(argc, argv);
+  } catch (const CLI::ParseError& e) {
+    int exit_code {app.exit(e)};
+    MPI_Finalize();
+    return exit_code;
+  }
+
+  {
+    simulation_space::mpi_domain domain {
+        model_params_file, mc_params_file, MPI_COMM_WORLD};
+    domain.anneal();
+  }
+
+  MPI_Finalize();
+  return 0;
+}
@@ -0,0 +1,84 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef CHEMICAL_POTENTIAL_SCAN_HEADER_H
+#define CHEMICAL_POTENTIAL_SCAN_HEADER_H
+
+/*
+ * Density scan in the grand-canonical ensemble. At every temperature of the
+ * schedule, the same shift is added to the chemical potentials of all types
+ * (the chemical_potentials model parameter) for every value of the scan in
+ * turn, and the system evolves with the insert_remove moves of move_probas,
+ * starting each value from the configuration reached at the previous one.
+ * The histogram of the number of particles N is recorded at every value, so
+ * that one run replaces a series of runs at fixed particle numbers.
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Chemical potential scan parameters, read from the same file as the
+   * mc_parameters_struct:
+   * mu_scan_shifts  - shifts added to the chemical potentials, in order. If
+   *                   absent, mu_scan_n_steps shifts are spread evenly from
+   *                   mu_scan_min to mu_scan_max
+   * mu_scan_output  - prefix of the output files. Defaults to
+   *                   final_structure_address + "mu_scan_"
+   */
+  struct mu_scan_parameters_struct{
+    mu_scan_parameters_struct(std::string& mc_input,
+                              const mc_parameters_struct& mc_parameters);
+    vec1d shifts {};
+    std::string output {};
+  };
+
+  class chemical_potential_scan {
+    private:
+      mu_scan_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Temperatures of the schedule, in order
+      vec1d T_array {};
+
+      // Histogram of N at every shift, for N from 0 to the largest value
+      // met, grown as N is sampled
+      std::vector<std::vector<long>> histograms {};
+
+      // Line per shift: shift, <N>, <N^2> - <N>^2, <E>, and <N_t> per type
+      vec2d averages {};
+
+      // Sample the system at temperature T with the chemical potentials
+      // shifted by the k-th shift
+      void sample_shift(model_space::model &simulation_model,
+                        const vec1d& base_chemical_potentials,
+                        std::size_t k,
+                        double T);
+
+      // Save the histograms and the averages at temperature T
+      void save_results(double T);
+
+    public:
+      chemical_potential_scan(std::string& mc_input,
+                              const mc_parameters_struct& mc_params,
+                              const vec1d& temperatures);
+
+      // Run the scan from the configuration of simulation_model, which is
+      // left in the state reached at the last shift and temperature, with
+      // its original chemical potentials
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
@@ -0,0 +1,87 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef FORKED_ANNEALING_HEADER_H
+#define FORKED_ANNEALING_HEADER_H
+
+/*
+ * Annealing of several seeds of the same design which share their
+ * high-temperature prefix. At the temperatures of the schedule above fork_T,
+ * where the system is disordered and all seeds are statistically identical,
+ * a single copy of the model is annealed. At the first temperature at or
+ * below fork_T, it is cloned (configuration, interactions and a reseeded
+ * random number generator) into n_forks replicas, which go through the rest
+ * of the schedule independently and in parallel.
+ */
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "thread_pool.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Forked annealing parameters, read from the same file as the
+   * mc_parameters_struct:
+   * fork_T       - temperature at or below which the replicas are forked
+   * n_forks      - number of replicas. Defaults to the number of threads
+   * fork_output  - file where T, replica index (-1 before the fork), <E> and
+   *                <E^2> are written. Defaults to
+   *                final_structure_address + "forked_annealing.dat"
+   */
+  struct fork_parameters_struct{
+    fork_parameters_struct(std::string& mc_input,
+                           const mc_parameters_struct& mc_parameters);
+    double fork_T {};
+    int n_forks {0};
+    std::string fork_output {};
+  };
+
+  class forked_annealing {
+    private:
+      fork_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Temperatures of the schedule, in order
+      vec1d T_array {};
+
+      // Threads updating the replicas
+      thread_space::ThreadPool pool;
+
+      // Random number generator seeding the replicas
+      std::mt19937 rng {};
+
+      // Replicas after the fork
+      std::vector<model_space::model> replicas {};
+
+      // Line per temperature and replica: T, replica index, <E>, <E^2>
+      vec2d fork_records {};
+
+      // Run mcs_eq then mcs_av lattice updates of system at temperature T,
+      // and return <E> and <E^2>
+      vec1d simulate(model_space::model& system, double T);
+
+      void save_fork_records();
+
+    public:
+      forked_annealing(std::string& mc_input,
+                       const mc_parameters_struct& mc_params,
+                       const vec1d& temperatures);
+
+      // Anneal simulation_model down to fork_T, then the replicas forked from
+      // it down to the end of the schedule
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
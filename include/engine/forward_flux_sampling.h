@@ -0,0 +1,129 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef FORWARD_FLUX_SAMPLING_HEADER_H
+#define FORWARD_FLUX_SAMPLING_HEADER_H
+
+/*
+ * Forward flux sampling (FFS) of the nucleation of aggregates, with the size
+ * n of the largest cluster as order parameter and interfaces
+ * lambda_0 < lambda_1 < ... < lambda_m.
+ *
+ * 1. Flux stage: walkers run in the basin n <= basin, and every time one
+ *    goes from the basin to n >= lambda_0 its configuration is stored. The
+ *    flux through lambda_0 is the number of crossings divided by the number
+ *    of lattice updates.
+ * 2. For every interface i, n_trials short trajectories start from
+ *    configurations picked at random among those stored at lambda_i, and
+ *    run until they reach lambda_i+1 (success, the configuration is stored)
+ *    or fall back into the basin (failure). P(lambda_i+1 | lambda_i) is the
+ *    fraction of successes.
+ * The nucleation rate is the flux times the product of the probabilities, in
+ * inverse lattice updates. Every stored configuration remembers the one it
+ * started from, so the configurations reaching lambda_m trace back the
+ * transition path ensemble.
+ *
+ * Walkers and trials are independent and run on the thread pool. n is
+ * measured after every lattice update.
+ */
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "thread_pool.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Forward flux sampling parameters, read from the same file as the
+   * mc_parameters_struct:
+   * ffs_interfaces    - increasing largest cluster sizes lambda_0 ...
+   *                     lambda_m
+   * ffs_basin         - largest cluster size below which the system is in
+   *                     the initial basin. Defaults to lambda_0 - 1
+   * ffs_n_crossings   - configurations collected at lambda_0
+   * ffs_n_trials      - trial trajectories fired from every interface
+   * ffs_max_sweeps    - maximal number of lattice updates of a walker of the
+   *                     flux stage, and of a trial (which then fails)
+   * ffs_output        - prefix of the output files. Defaults to
+   *                     final_structure_address + "ffs_"
+   */
+  struct ffs_parameters_struct{
+    ffs_parameters_struct(std::string& mc_input,
+                          const mc_parameters_struct& mc_parameters);
+    vec1i interfaces {};
+    int basin {};
+    int n_crossings {100};
+    int n_trials {100};
+    long max_sweeps {100000};
+    std::string output {};
+  };
+
+  // Configuration stored at an interface, with the index of the
+  // configuration of the previous interface its trial started from (-1 at
+  // lambda_0)
+  struct ffs_configuration_struct{
+    particles_space::SiteVector sites {};
+    int parent {-1};
+  };
+
+  class forward_flux_sampling {
+    private:
+      ffs_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Temperatures of the schedule, in order
+      vec1d T_array {};
+
+      // Threads, each one updating its own walker
+      thread_space::ThreadPool pool;
+      std::vector<model_space::model> walkers {};
+
+      // Random number generator picking the starting points and seeds of the
+      // trials
+      std::mt19937 rng {};
+
+      // Configurations reached at every interface
+      std::vector<std::vector<ffs_configuration_struct>> configurations {};
+
+      // Trials fired from and reaching every interface but the last one
+      std::vector<long> n_fired {};
+      std::vector<long> n_successes {};
+
+      // Line per temperature: T, flux through lambda_0, rate
+      vec2d rate_records {};
+
+      // Collect the configurations at lambda_0, starting from
+      // initial_sites. Returns the flux through lambda_0
+      double run_flux_stage(const particles_space::SiteVector& initial_sites,
+                            double T);
+
+      // Fire the trials from interface i, storing the configurations
+      // reaching interface i + 1
+      void run_trials(std::size_t i, double T);
+
+      // Save the interface statistics and the transition path ensemble
+      void save_interfaces(double T);
+      void save_paths(double T);
+
+    public:
+      forward_flux_sampling(std::string& mc_input,
+                            const mc_parameters_struct& mc_params,
+                            const vec1d& temperatures);
+
+      // Run the forward flux sampling from the configuration of
+      // simulation_model at every temperature of the schedule
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
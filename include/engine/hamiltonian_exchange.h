@@ -0,0 +1,114 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef HAMILTONIAN_EXCHANGE_HEADER_H
+#define HAMILTONIAN_EXCHANGE_HEADER_H
+
+/*
+ * Hamiltonian replica exchange: replicas of the model share the temperature
+ * but each one uses its own couplings, taken from the replica_couplings model
+ * parameter. Every exchange_interval lattice updates, replicas holding
+ * neighbouring couplings k and k + 1 attempt to exchange them, which is
+ * accepted with probability
+ *   min(1, exp(-beta * (H_k(x_j) + H_k+1(x_i) - H_k(x_i) - H_k+1(x_j)))),
+ * where x_i is the configuration of the replica holding H_k and x_j that of
+ * the replica holding H_k+1. Exchanging the couplings rather than the
+ * configurations avoids copying the lattices.
+ * The temperature follows the schedule of the mc class, so that a single
+ * temperature step gives equilibrium samples along the whole list of
+ * couplings.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "thread_pool.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Hamiltonian exchange parameters, read from the same file as the
+   * mc_parameters_struct:
+   * n_replicas          - optional: if the model has exactly two
+   *                       replica_couplings, they are the end points of
+   *                       n_replicas linearly interpolated couplings
+   * exchange_interval   - lattice updates between exchange attempts
+   * exchange_output     - file where T, coupling index, <E>, <E^2> and the
+   *                       acceptance rate of exchanges with the next couplings
+   *                       are written. Defaults to
+   *                       final_structure_address + "hamiltonian_exchange.dat"
+   */
+  struct exchange_parameters_struct{
+    exchange_parameters_struct(std::string& mc_input,
+                               const mc_parameters_struct& mc_parameters);
+    int n_replicas {0};
+    int exchange_interval {10};
+    std::string exchange_output {};
+  };
+
+  class hamiltonian_exchange {
+    private:
+      exchange_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Annealing temperatures, in order
+      vec1d T_array {};
+
+      // Couplings of every Hamiltonian, in order
+      vec2d couplings {};
+
+      // Replicas, and index of the replica holding each Hamiltonian
+      std::vector<model_space::model> replicas {};
+      std::vector<std::size_t> holders {};
+
+      // Threads updating the replicas
+      thread_space::ThreadPool pool;
+
+      // Random number generator used for the exchanges
+      std::mt19937 rng {};
+
+      // Attempted and accepted exchanges between Hamiltonians k and k + 1
+      std::vector<long> n_attempts {};
+      std::vector<long> n_accepted {};
+
+      // One line per temperature step and Hamiltonian:
+      // T, k, <E>, <E^2>, acceptance rate of the k <-> k + 1 exchanges
+      vec2d exchange_records {};
+
+      // Build the list of couplings from the model parameters
+      void set_couplings(model_space::model &simulation_model);
+
+      // Perform n_sweeps lattice updates of every replica at temperature T,
+      // with exchange attempts every exchange_interval updates. If e_av and
+      // e2_av are not empty, accumulate the energy of each Hamiltonian after
+      // every update
+      void sweep_replicas(double T, int n_sweeps, vec1d& e_av, vec1d& e2_av);
+
+      // Attempt the exchanges between the pairs (k, k + 1) with k of the
+      // given parity
+      void attempt_exchanges(double T, std::size_t parity);
+
+      void save_exchange_records();
+
+    public:
+      hamiltonian_exchange(std::string& mc_input,
+                           const mc_parameters_struct& mc_params,
+                           const vec1d& temperatures);
+
+      // Run the replica exchange starting from the configuration of
+      // simulation_model
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
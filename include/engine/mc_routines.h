@@ -18,7 +18,8 @@ namespace simulation_space{
 
   /*Monte Carlo parameters*/
   struct mc_parameters_struct{
-    mc_parameters_struct(std::string& mc_input);
+    // verbose is false on the MPI ranks other than 0
+    mc_parameters_struct(std::string& mc_input, bool verbose = true);
     int mcs_eq {};
     int mcs_av {};
     double Ti {};
@@ -28,6 +29,63 @@ namespace simulation_space{
     bool checkpoint_option {};
     std::string checkpoint_address {};
     std::string final_structure_address {};
+    // Optional: which engine runs the simulation (see mc::run)
+    std::string simulation_mode {"annealing"};
+    // Optional: number of threads used by engines that evolve several
+    // replicas. 0 picks the number of hardware threads
+    int n_threads {0};
+    // Optional: number of lanes of the lockstep mode. 0 uses one lane per
+    // entry of the replica_couplings model parameter
+    int n_lanes {0};
+    // Optional, "adaptive" cooling schedule only: target value of
+    // delta_beta * sigma_E between consecutive temperatures, and maximal
+    // total number of lattice updates (also the length of the
+    // "continuous_annealing" mode). The budget defaults to the cost of the
+    // fixed schedule, Nt * (mcs_eq + mcs_av)
+    double adaptive_step {1.0};
+    long sweep_budget {0};
+    // Optional: stop equilibrating once the energy series passes the MSER
+    // test, checked every check_interval lattice updates. mcs_eq stays an
+    // upper bound
+    bool auto_equilibration {false};
+    int check_interval {100};
+    // Optional: stop averaging once the batch-means error on <E> is below
+    // e_error_target (disabled if <= 0). mcs_av stays an upper bound
+    double e_error_target {0.0};
+    // Optional: quench the system to its nearest local energy minimum
+    // before saving the final structure of an annealing
+    bool final_quench {false};
+    // Optional: number of repetitions of the annealing schedule, and whether
+    // each repetition restarts from the lowest-energy configuration met so
+    // far (needs the best_state_option model parameter)
+    int n_cycles {1};
+    bool restart_from_best {false};
+    // Optional stopping rules: the run saves its state and stops as soon as
+    // the largest cluster holds at least stop_largest_cluster particles, the
+    // energy per particle is at most stop_energy_per_particle (both checked
+    // every stop_check_interval lattice updates), or no move was accepted
+    // for stop_frozen_sweeps lattice updates. 0 disables a rule. Only the
+    // "annealing" and "continuous_annealing" modes check them
+    int stop_check_interval {100};
+    int stop_largest_cluster {0};
+    double stop_energy_per_particle {-HUGE_VAL};
+    int stop_frozen_sweeps {0};
+    bool has_stop_rule() const;
+    // Optional, "continuous_annealing" mode only: number of lattice updates
+    // between temperature changes, and number of temperature windows in
+    // which the averages are binned (default Nt). The run lasts sweep_budget
+    // lattice updates
+    int sweeps_per_update {1};
+    int n_windows {0};
+    // Optional: at the temperatures at or below microcanonical_T, the
+    // moves are accepted by a Creutz demon instead of the Metropolis rule
+    // during averaging. The system is equilibrated with the Metropolis rule
+    // at T, then handed to a demon holding its mean energy at T, and the
+    // temperature is measured from the mean demon energy. With
+    // demon_energy_step > 0, energy changes are multiples of this step and
+    // the demon distribution is the discrete one
+    double microcanonical_T {-HUGE_VAL};
+    double demon_energy_step {0.0};
   };
 
   class mc {
@@ -39,26 +97,95 @@ namespace simulation_space{
       // Simulation parameters
       mc_parameters_struct parameters;
 
+      // Location of the MC input file, read again by the specialised engines
+      std::string mc_input_file {};
+
       // Integer option for annealing schedule
       int cooling_option {};
 
+      // Integer option for the simulation mode
+      int simulation_option {};
+
       //Array with annealing temperatures
       vec1d T_array {};
 
+      // Energy moments measured during the last call to mc_simulate
+      double e_av_measured {};
+      double e2_av_measured {};
+
+      // Line per microcanonical temperature step: T, mean demon energy and
+      // temperature measured from it
+      vec2d demon_records {};
+
+      // Lattice updates performed during the last call to mc_simulate
+      long last_sweeps {};
+
+      // State of the stopping rules
+      bool run_stopped {false};
+      int sweeps_since_stop_check {0};
+      int frozen_sweeps {0};
+      long last_n_accepted {-1};
+
     public:
 
       // Class constructor
-      mc(std::string& mc_input);
+      mc(std::string& mc_input, bool verbose = true);
 
       // Prints user-defined MC parameters
       void print_mc_parameters();
 
+      // Runs the simulation selected by parameters.simulation_mode
+      void run(model_space::model &simulation_model);
+
+      // Temperature of the i-th annealing step, following the cooling
+      // schedule
+      double get_temperature(std::size_t i);
+
+      // Temperature corresponding to the value x of the schedule variable,
+      // which is linear in T, log10(T) or 1/T depending on the cooling
+      // schedule
+      double apply_cooling_law(double x);
+
+      // All the temperatures of the annealing, in order
+      vec1d get_temperatures();
+
       // MC annealing
       void extracted();
       void t_scan(model_space::model &simulation_system);
 
+      // One cycle of MC annealing where each temperature step is chosen from
+      // the energy fluctuations measured at the previous one. checkpoint is
+      // the index of the next checkpoint file, advanced at every step
+      void adaptive_t_scan(model_space::model &simulation_system,
+                           std::size_t& checkpoint);
+
       // MC simmulation at a fixed temperature T
       void mc_simulate(model_space::model &simulation_model, double T);
+
+      // Record the temperature measured by the Creutz demon at T, from its
+      // mean energy demon_av, to demon_temperatures.dat
+      void save_demon_temperature(double T, double demon_av);
+
+      // MC annealing of several lanes of the model updated in lockstep
+      void lockstep_scan(model_space::model &simulation_model);
+
+      // MC annealing where the temperature changes every sweeps_per_update
+      // lattice updates instead of in Nt plateaus
+      void continuous_scan(model_space::model &simulation_model);
+
+      // Evaluate the stopping rules after a lattice update. Returns true, and
+      // sets run_stopped, if the run should stop
+      bool is_stop_rule_met(model_space::model &simulation_model);
+
+      // Zero-temperature quench of the current configuration
+      void quench(model_space::model &simulation_model);
+
+      // Exact thermodynamics of the infinite chain or strip at the annealing
+      // temperatures, from its transfer matrix
+      void transfer_matrix_scan(model_space::model &simulation_model);
+
+      // Save the final configuration, and the best one if it is tracked
+      void save_final_state(model_space::model &simulation_model);
   };
 }
 
@@ -0,0 +1,153 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef MPI_DOMAIN_HEADER_H
+#define MPI_DOMAIN_HEADER_H
+
+/*
+ * Annealing of a lattice of particles decomposed into slabs, one per MPI
+ * rank. Built as the frusa_mc_mpi executable when FRUSA_MPI is ON.
+ *
+ * The lattice is cut along its slowest axis (x for a chain, y in 2D, z in
+ * 3D), so that every rank owns a contiguous block of layers, i.e. a
+ * contiguous range of site indices. A rank stores its layers plus a halo
+ * layer on each side, copied from the neighbouring ranks, in a local Geometry
+ * of the same lattice: since bonds never span more than one layer, the
+ * energies of the owned sites are computed with the usual particles routines.
+ *
+ * Updates follow a checkerboard schedule on the two halves of every slab.
+ * All the ranks update the lower half of their slab, whose only remote
+ * neighbours sit in the upper half of the rank below, then exchange their
+ * halos, then do the same with their upper halves. Moves only involve sites
+ * of the half being updated, so the global swap moves are replaced by hops
+ * and exchanges between neighbouring sites:
+ * - swap_empty_full:           hop of a particle to an empty neighbour
+ * - rotate_and_swap_w_empty:   hop with a random rotation
+ * - swap_full_full:            exchange of two neighbouring particles
+ * The other moves are unchanged.
+ */
+
+#include <mpi.h>
+
+#include <string>
+
+#include "geometry.h"
+#include "mc_routines.h"
+#include "particles_interactions.h"
+#include "particles_parameters.h"
+#include "particles_state.h"
+#include "vector_utils.h"
+
+namespace simulation_space{
+
+  /*
+   * Share of the lattice owned by one rank, read from the model parameters
+   * file:
+   * lattice          - lattice of the whole system
+   * lx, ly, lz       - dimensions of the whole system
+   * layer_size       - number of sites in a layer of the decomposed axis
+   * n_layers         - number of layers owned by the rank, at least 2
+   * first_layer      - index of the first owned layer in the whole system
+   * local_l*         - dimensions of the local lattice, whose decomposed axis
+   *                    holds n_layers + 2 layers: the halo below the slab,
+   *                    the owned layers, and the halo above it
+   */
+  struct slab_struct{
+    slab_struct(std::string& model_input, MPI_Comm comm, int rank,
+                int n_ranks);
+    geometry_space::lattice_options lattice {};
+    int lx {};
+    int ly {};
+    int lz {};
+    int n_sites {};
+    int layer_size {};
+    int n_layers {};
+    int first_layer {};
+    int local_lx {};
+    int local_ly {};
+    int local_lz {};
+  };
+
+  class mpi_domain {
+    private:
+      MPI_Comm comm;
+      int rank {};
+      int n_ranks {};
+      // Ranks owning the slabs above and below this one (periodic)
+      int rank_up {};
+      int rank_down {};
+
+      particles_space::model_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Annealing temperatures, in order
+      vec1d T_array {};
+
+      slab_struct slab;
+      geometry_space::Geometry geometry;
+      particles_space::state_struct state {};
+      particles_space::interactions_struct interactions {};
+
+      // Energy of the whole system when the run started, and sum of the
+      // energy changes caused by the moves of this rank since then
+      double initial_energy {};
+      double local_energy_change {};
+
+      // Full sites of the half of the slab being updated
+      vec1i active_full_sites {};
+
+      // Number of layers by which the lattice has been translated towards
+      // the lower ranks since the start of the run
+      int layer_shift {};
+
+      // Line per temperature: T, <E>, <E^2>. Rank 0 only
+      vec2d energy_records {};
+
+      // Fill the owned layers from the state_input file, or at random with a
+      // share of the particles of every type proportional to the slab size
+      void initialize_slab();
+
+      // Copy the first and last owned layers into the halos of the
+      // neighbouring ranks
+      void exchange_halos();
+
+      // Update both halves of the slab in turn, exchanging the halos after
+      // each one, then shift the slab
+      void update_slab(double T);
+
+      // Translate the lattice by one layer towards the lower ranks, so that
+      // the boundaries between the halves and between the ranks, which no
+      // move can cross, sweep through the whole system
+      void shift_slab();
+
+      // One attempt per site on the local sites [first_site, last_site)
+      void update_half(int first_site, int last_site, double T);
+
+      // Attempt a move of the particle stored at position of
+      // active_full_sites, keeping all the modified sites in
+      // [first_site, last_site). Returns the energy change
+      double attempt_local_move(particles_space::mc_moves chosen_move,
+                                std::size_t position,
+                                int first_site,
+                                int last_site,
+                                double T);
+
+      // Energy of the whole system, known on rank 0 only
+      double reduce_energy();
+
+      // Gather the slabs on rank 0 and save them as one structure file
+      void save_global_state(std::string state_output);
+
+    public:
+      mpi_domain(std::string& model_input, std::string& mc_input,
+                 MPI_Comm communicator);
+      // A domain holds one slab of a run shared with the other ranks
+      mpi_domain(const mpi_domain&) = delete;
+      mpi_domain& operator=(const mpi_domain&) = delete;
+
+      // Anneal along the temperatures of the MC parameters file
+      void anneal();
+  };
+}
+
+#endif
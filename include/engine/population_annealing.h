@@ -0,0 +1,108 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef POPULATION_ANNEALING_HEADER_H
+#define POPULATION_ANNEALING_HEADER_H
+
+/*
+ * Population annealing: a population of n_replicas copies of the model is
+ * cooled along the temperature schedule of the mc class. At every temperature
+ * step the replicas are reweighted by exp(-(beta_new - beta_old) * E) and
+ * resampled, which keeps the population close to equilibrium and provides an
+ * estimate of the free energy along the way. With insert_remove moves, E is
+ * replaced by E - sum_t mu_t N_t and the estimate is the grand potential. Between resampling steps, the
+ * replicas are updated independently on a pool of threads.
+ */
+
+#include <iostream>
+#include <cmath>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "thread_pool.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Population annealing parameters, read from the same file as the
+   * mc_parameters_struct:
+   * n_replicas        - size of the population
+   * population_output - file where the population observables are written at
+   *                     every temperature step. Defaults to
+   *                     final_structure_address + "population_annealing.dat"
+   * restart_step      - if >= 0, restart from the population checkpointed at
+   *                     this temperature step (requires checkpoint_option)
+   */
+  struct population_parameters_struct{
+    population_parameters_struct(std::string& mc_input,
+                                 const mc_parameters_struct& mc_parameters);
+    int n_replicas {};
+    std::string population_output {};
+    int restart_step {-1};
+  };
+
+  class population_annealing {
+    private:
+      // Parameters of the population and of the annealing
+      population_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Annealing temperatures, in order
+      vec1d T_array {};
+
+      // The population of replicas
+      std::vector<model_space::model> replicas {};
+
+      // Threads updating the replicas
+      thread_space::ThreadPool pool;
+
+      // Random number generator used for resampling and reseeding
+      std::mt19937 rng {};
+
+      // Running estimate of beta * F, relative to its value at T_array[0]
+      double beta_f {0.0};
+
+      // One line per temperature step:
+      // T, <E>, <E^2>, beta * F, effective population size
+      vec2d population_records {};
+
+      // Perform n_sweeps lattice updates of every replica at temperature T,
+      // and return the population averages of E and E^2 over the last
+      // n_av_sweeps updates
+      void sweep_replicas(double T, int n_sweeps, int n_av_sweeps,
+                          double& e_av, double& e2_av);
+
+      // Reweight the replicas by exp(-delta_beta * E) and resample them.
+      // Returns the effective population size before resampling and updates
+      // beta_f
+      double resample(double delta_beta);
+
+      // Save and load the population at temperature step "step"
+      void save_population(std::size_t step);
+      void load_population(std::size_t step);
+
+      // Read back the records of the first n_steps temperature steps, so
+      // that a restarted run keeps them in its output
+      void load_population_records(std::size_t n_steps);
+      void save_population_records();
+
+    public:
+      population_annealing(std::string& mc_input,
+                           const mc_parameters_struct& mc_params,
+                           const vec1d& temperatures);
+
+      // Anneal a population of replicas of simulation_model, which is
+      // replaced by the lowest-energy replica at the end
+      void anneal(model_space::model &simulation_model);
+  };
+}
+
+#endif
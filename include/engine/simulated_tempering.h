@@ -0,0 +1,109 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef SIMULATED_TEMPERING_HEADER_H
+#define SIMULATED_TEMPERING_HEADER_H
+
+/*
+ * Simulated tempering: a single replica performs a random walk on the
+ * temperatures T_0, ..., T_n-1 of the schedule. Every tempering_interval
+ * lattice updates, a hop from T_m to a neighbouring temperature T_l is
+ * accepted with probability
+ *   min(1, exp(-(beta_l - beta_m) E + g_l - g_m)),
+ * where g_m are log weights which make all temperatures equally visited when
+ * g_m = -ln Z(T_m). They are learned on the fly with the Wang-Landau scheme:
+ * after every hop attempt, g of the current temperature is lowered by f, and
+ * f is halved whenever the histogram of visits is flat, until it falls below
+ * tempering_f_final. The weights are then frozen, and the production stage
+ * samples the energy at every temperature.
+ * Only one lattice is held, so the memory cost is that of a single replica.
+ */
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Simulated tempering parameters, read from the same file as the
+   * mc_parameters_struct:
+   * tempering_interval       - lattice updates between temperature hops
+   * tempering_f_initial      - initial Wang-Landau modification factor
+   * tempering_f_final        - the learning stage stops when the factor
+   *                            falls below this value
+   * tempering_flatness       - the histogram of visits is flat when its
+   *                            smallest entry is above this fraction of its
+   *                            mean
+   * tempering_learning_sweeps - maximal number of lattice updates of the
+   *                            learning stage. Defaults to Nt * mcs_eq
+   * tempering_output         - file where T, g, the number of lattice
+   *                            updates at T, <E> and <E^2> of the
+   *                            production stage are written.
+   *                            Defaults to final_structure_address +
+   *                            "simulated_tempering.dat"
+   * The production stage lasts Nt * mcs_av lattice updates.
+   */
+  struct tempering_parameters_struct{
+    tempering_parameters_struct(std::string& mc_input,
+                                const mc_parameters_struct& mc_parameters);
+    int interval {1};
+    double f_initial {1.0};
+    double f_final {1e-4};
+    double flatness {0.8};
+    long learning_sweeps {};
+    std::string output {};
+  };
+
+  class simulated_tempering {
+    private:
+      tempering_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Temperatures of the grid, in the order of the schedule
+      vec1d T_array {};
+
+      // Random number generator of the temperature hops
+      std::mt19937 rng {};
+
+      // Current temperature index, log weights, and visits of each
+      // temperature: one per hop attempt while learning, one per lattice
+      // update during production
+      std::size_t current {0};
+      vec1d log_weights {};
+      std::vector<long> visits {};
+
+      // Energy moments at each temperature during production
+      vec1d e_sums {};
+      vec1d e2_sums {};
+
+      // Attempt a hop to a neighbouring temperature
+      void attempt_hop(model_space::model &simulation_model);
+
+      // Whether the smallest number of visits is above flatness times their
+      // mean
+      bool is_histogram_flat();
+
+      void save_results();
+
+    public:
+      simulated_tempering(std::string& mc_input,
+                          const mc_parameters_struct& mc_params,
+                          const vec1d& temperatures);
+
+      // Learn the weights, then sample every temperature, starting from the
+      // configuration of simulation_model at the first temperature
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
@@ -0,0 +1,93 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef UMBRELLA_SAMPLING_HEADER_H
+#define UMBRELLA_SAMPLING_HEADER_H
+
+/*
+ * Umbrella sampling on the size n of the largest cluster. Every window is an
+ * independent replica of the model whose moves are biased by a harmonic
+ * potential
+ *   U_k(n) = spring / 2 * (n - center_k)^2,
+ * optionally restricted to [center_k - window_width, center_k + window_width].
+ * The windows run in parallel, and at every temperature of the schedule the
+ * histogram of n sampled in each window is saved along with the bias that
+ * produced it, which is the input of the weighted histogram analysis method
+ * (WHAM) giving the free energy profile F(n).
+ *
+ * The bias is evaluated after every move which fills or empties a site. The
+ * clusters are tracked by the ClusterTracker of the model state, so such a
+ * move only visits the clusters around the site rather than the whole
+ * lattice.
+ */
+
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <json.hpp>
+
+#include "mc_routines.h"
+#include "model.h"
+#include "thread_pool.h"
+#include "vector_utils.h"
+
+using json = nlohmann::json;
+
+namespace simulation_space{
+
+  /*
+   * Umbrella sampling parameters, read from the same file as the
+   * mc_parameters_struct:
+   * umbrella_centers      - centers of the windows. If absent,
+   *                         umbrella_n_windows centers are spread evenly
+   *                         between umbrella_min and umbrella_max
+   * umbrella_spring       - spring constant of the harmonic bias
+   * umbrella_window_width - optional half-width of the hard windows around
+   *                         the centers, 0 for no hard window
+   * umbrella_output       - prefix of the output files. Defaults to
+   *                         final_structure_address + "umbrella_"
+   */
+  struct umbrella_parameters_struct{
+    umbrella_parameters_struct(std::string& mc_input,
+                               const mc_parameters_struct& mc_parameters);
+    vec1d centers {};
+    double spring {1.0};
+    int window_width {0};
+    std::string output {};
+  };
+
+  class umbrella_sampling {
+    private:
+      umbrella_parameters_struct parameters;
+      mc_parameters_struct mc_parameters;
+
+      // Temperatures of the schedule, in order
+      vec1d T_array {};
+
+      // One replica per window
+      std::vector<model_space::model> windows {};
+
+      // Threads updating the windows
+      thread_space::ThreadPool pool;
+
+      // Histograms of the largest cluster size of every window, for sizes
+      // from 0 to the largest one met, grown as the sizes are sampled
+      std::vector<std::vector<long>> histograms {};
+
+      // Save the histograms at temperature T and the WHAM metadata file
+      // listing them with their bias
+      void save_histograms(double T);
+
+    public:
+      umbrella_sampling(std::string& mc_input,
+                        const mc_parameters_struct& mc_params,
+                        const vec1d& temperatures);
+
+      // Run every window from the configuration of simulation_model
+      void run(model_space::model &simulation_model);
+  };
+}
+
+#endif
@@ -31,6 +31,8 @@ namespace geometry_space {
             //{{1, 0, 0}, 0},
             //{{-1, 0, 0}, 1},
         //}; // bond_index
+
+        static inline const vec1i opposite_bonds {1, 0};
       }; // bond_structure
 
     //void get_bond();
@@ -39,6 +39,24 @@ using BondIndexMap = std::map<std::array<int,3> , int>;
 
 namespace geometry_space
 {
+// Order in which the sites are stored in memory. Sites are numbered in
+// row-major order of their (i, j, k) coordinates by default. With the Morton
+// order, sites which are close on the lattice are close in memory, which keeps
+// the neighbourhood of a site in a few cache lines on large lattices. Files
+// always store the sites in row-major order.
+enum site_ordering_options
+{
+  row_major,
+  morton,
+  n_site_orderings
+};
+
+static const inline std::array<std::string,
+                               site_ordering_options::n_site_orderings>
+    site_ordering_str_arr {"row_major", "morton"};
+
+site_ordering_options get_site_ordering_from_str(std::string& ordering_str);
+
 // Vectors of vectors giving the permutation indices for all the possible bond
 // orientations.
 enum lattice_options
@@ -100,15 +118,55 @@ public:
   int get_n_orientations() const { return n_orientations_m; };
   int get_n_sites() const { return n_sites_m; };
   int get_n_neighbours() const { return n_neighbours_m; };
+  lattice_options get_lattice() const { return lattice_m; };
+  int get_lx() const { return lx_m; };
+  int get_ly() const { return ly_m; };
+  int get_lz() const { return lz_m; };
+  site_ordering_options get_site_ordering() const { return site_ordering_m; };
+
+  // ----- CONVERSION BETWEEN SITE INDICES AND ROW-MAJOR INDICES -----
+  // Row-major index r = i + lx * (j + ly * k) of a site
+  int get_row_major_index(const int site_ind) const
+  {
+    if (row_major_of_site_m.empty()) return site_ind;
+    return row_major_of_site_m[static_cast<std::size_t>(site_ind)];
+  };
+  // Site index of a row-major index
+  int get_site_index(const int row_major_ind) const
+  {
+    if (site_of_row_major_m.empty()) return row_major_ind;
+    return site_of_row_major_m[static_cast<std::size_t>(row_major_ind)];
+  };
+  // Site index of every row-major index. Empty for the row-major ordering
+  const vec1i& get_site_of_row_major() const { return site_of_row_major_m; };
 
   // ----- GETTERS FOR NEIGHBOURING PARTICLES  AND SITES -----
-  int get_neighbour(const int site_ind, const int bond_ind) const;
+  // Without a neighbour table, neighbours are computed from the lattice
+  // coordinates
+  int get_neighbour(const int site_ind, const int bond_ind) const
+  {
+    if (neighbour_table_m.empty()) {
+      return compute_neighbour(site_ind, bond_ind);
+    }
+    return neighbour_table_m[static_cast<std::size_t>(
+        site_ind * n_neighbours_m + bond_ind)];
+  };
+  // Flat table of neighbour indices: the neighbour of site s through bond b
+  // is stored at s * n_neighbours + b. Empty if the geometry is sparse
+  const vec1i& get_neighbour_table() const { return neighbour_table_m; };
+  // Whether the geometry holds no per-site data, for very large lattices
+  bool is_sparse() const { return sparse_m; };
   int get_bond(const int site_1_ind, const int site_2_ind) const;
   int get_opposite_bond(const int bond) const
   {
     std::size_t u_bond {static_cast<std::size_t>(bond)};
     return bond_struct_m.opposite_bonds[u_bond];
   };
+  // Face presented through bond by a particle in each orientation
+  const vec1i& get_bond_permutation(const int bond) const
+  {
+    return bond_struct_m.bond_permutation[static_cast<std::size_t>(bond)];
+  };
   bool are_neighbours(const int bond_index);
   bool are_neighbours(const int site_1_ind, const int site_2_ind);
 
@@ -197,8 +255,21 @@ private:
   int n_sites_m {1};
   // Structure describing how neighbouring sites are linked
   bond_struct bond_struct_m {bond_struct(chain)};
+  // Neighbours of every site, computed once at construction unless the
+  // geometry is sparse
+  bool sparse_m {false};
+  vec1i neighbour_table_m {};
+  // Order of the sites in memory, and the permutations between site indices
+  // and row-major indices. Both are left empty for the row-major ordering
+  site_ordering_options site_ordering_m {site_ordering_options::row_major};
+  vec1i row_major_of_site_m {};
+  vec1i site_of_row_major_m {};
 
   void set_lattice_properties();
+  void set_site_ordering();
+  // Neighbour of a site computed from its lattice coordinates
+  int compute_neighbour(const int site_ind, const int bond_ind) const;
+  void set_neighbour_table();
 };
 
 }  // namespace geometry_space
@@ -24,6 +24,9 @@
 #include "particles_state.h"
 #include "particles_update.h"
 #include "particles_records.h"
+#include "particles_lockstep.h"
+#include "particles_quench.h"
+#include "particles_transfer_matrix.h"
 
 namespace model_space {
 
@@ -67,6 +70,9 @@ private:
   // Structure containing records of energy after each lattice update
   particles_space::records_struct records;
 
+  // Replicas of the system updated in lockstep
+  particles_space::lockstep_struct lockstep;
+
 public:
   /*Class constructor*/
   model(std::string& model_params_file);
@@ -87,6 +93,9 @@ public:
 
   void print_model_energy();
 
+  // Print the hit rate and memory of the energy change cache, if enabled
+  void print_model_cache_statistics();
+
   // Update the state of the system at annealing temperature T
   void update_model_system(double T);
 
@@ -104,6 +113,122 @@ public:
 
   // Save a set of recorded energies after a lattice update
   void save_model_records(double T);
+
+  /*
+   * Routines used by the engines that handle several replicas of the model
+   */
+
+  // Current total energy of the system
+  double get_model_energy();
+
+  // Energy minus sum_t mu_t N_t, whose Boltzmann weight is the one sampled
+  // once insert_remove moves are enabled. Equal to the energy otherwise
+  double get_model_grand_energy();
+
+  // Reseed the random number generator, so that copies of a model do not
+  // follow the same trajectory
+  void reseed_model_rng(unsigned int seed);
+
+  // Copy the configuration (and its energy) of another replica of the same
+  // model, keeping our own random number generator
+  void copy_model_state(const model& other);
+
+  // Replace the current configuration by one saved with save_model_state
+  void load_model_state(const std::string& state_input);
+
+  // Current configuration of the lattice, and replacement of the
+  // configuration by one taken from a replica of the same model
+  particles_space::SiteVector get_model_configuration();
+  void set_model_configuration(const particles_space::SiteVector& sites);
+
+  // Number of particles on the lattice
+  int get_model_n_particles();
+
+  // Number of lattice sites, and number of particles of each type
+  int get_model_n_sites();
+  vec1i get_model_particle_numbers();
+
+  // Chemical potential of each type, used by the insert_remove moves
+  vec1d get_model_chemical_potentials();
+  void set_model_chemical_potentials(const vec1d& chemical_potentials);
+
+  // Whether insert_remove moves are enabled, so that the number of particles
+  // fluctuates
+  bool is_grand_canonical();
+
+  // Number of particles in the largest cluster
+  int get_model_largest_cluster();
+
+  // Bias the moves with an umbrella potential spring / 2 * (n - center)^2 on
+  // the size n of the largest cluster, rejecting the moves which take n
+  // further away from [window_min, window_max]
+  void set_model_umbrella(double center,
+                          double spring,
+                          int window_min,
+                          int window_max);
+
+  // Switch the Creutz demon acceptance on or off, with the given demon
+  // energy. Heat-bath and insert_remove moves do not go through the demon,
+  // so they cannot be combined with it.
+  void set_model_demon(bool option, double energy);
+  double get_model_demon_energy();
+
+  // Number of moves accepted since the start of the run
+  long get_model_n_accepted_moves();
+
+  // Couplings of the replicas, from the replica_couplings model parameter
+  vec2d get_model_replica_couplings();
+
+  // Energy of the current configuration with other couplings
+  double get_model_energy(const vec1d& other_couplings);
+
+  // Replace the couplings, and compute the new energy of the system. The
+  // second version takes the new energy if it is already known. Both restart
+  // the record of the best configuration, whose energy was measured with the
+  // old couplings.
+  void set_model_couplings(const vec1d& new_couplings);
+  void set_model_couplings(const vec1d& new_couplings, double new_energy);
+
+  /*
+   * Lowest-energy configuration met during the run, kept if the
+   * best_state_option model parameter is set
+   */
+
+  bool is_best_state_tracked();
+
+  double get_model_best_energy();
+
+  // Save the best configuration to a file "state_output"
+  void save_model_best_state(std::string& state_output);
+
+  // Go back to the best configuration
+  void restore_model_best_state();
+
+  // Bring the system to the nearest local energy minimum with downhill
+  // moves. Returns the number of moves applied.
+  long quench_model();
+
+  // Exact free energy, energy, heat capacity and densities per site of the
+  // infinite chain or strip with the lattice of the model, one line per
+  // temperature
+  vec2d get_model_exact_thermodynamics(const vec1d& temperatures);
+
+  /*
+   * Lockstep update of several replicas (lanes) of the current configuration
+   */
+
+  // Create n_lanes lanes. n_lanes <= 0 uses one lane per entry of the
+  // replica_couplings model parameter
+  void initialize_model_lockstep(int n_lanes);
+
+  // Update every lane at annealing temperature T
+  void update_model_lockstep(double T);
+
+  // Current energies of the lanes
+  vec1d get_model_lockstep_energies();
+
+  // Save the state of a lane to a file "state_output"
+  void save_model_lockstep_state(int lane, std::string& state_output);
 };
 } // namespace model_space
 #endif
@@ -13,13 +13,55 @@
 
 #include <array>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 
+#include "fenwick_tree.h"
 #include "vector_utils.h"
 #include "geometry.h"
 
 namespace particles_space {
 
+/**
+ * Direct-mapped cache of the energy change of a single-site move (rotation or
+ * mutation). The key encodes the old and new states of the site and the
+ * states of its neighbours in bond order, so an entry is never stale as long
+ * as the couplings do not change. Every key maps to one slot, where it
+ * overwrites the previous entry, so the memory is fixed by the number of
+ * slots. The cache is only enabled when the key fits in 64 bits, which holds
+ * for (n_states + 1)^(n_neighbours + 2) < 2^63.
+ */
+struct delta_e_cache_struct {
+  bool option{false};
+  // Slots, whose number is a power of two, and bits of the slot index
+  std::vector<std::uint64_t> keys{};
+  vec1d delta_e{};
+  int index_bits{0};
+  // Statistics since the start of the run
+  long n_lookups{0};
+  long n_hits{0};
+};
+
+/**
+ * Energy of every site, used to pick the particles of the rotations and
+ * mutations with a probability proportional to exp(bias * site energy), so
+ * that frustrated and surface particles are tried more often than those in
+ * the bulk of a crystal. The energies are updated incrementally after every
+ * accepted move, and rebuilt only when the configuration or the couplings are
+ * replaced.
+ */
+struct site_energy_field_struct {
+  bool option{false};
+  double bias{0.0};
+  vec1d energies{};
+  // Selection weights, zero on empty sites
+  fenwick_space::FenwickTree weights{};
+  // Sites whose energy is changed by the move being attempted, and their
+  // energy after the move
+  vec1i changed_sites{};
+  vec1d changed_energies{};
+};
+
 // Structure containing the characteristics of the model interactions:
 struct interactions_struct {
   // Interaction energy between neighbouring particles, flattened into 1
@@ -29,6 +71,17 @@ struct interactions_struct {
   double energy{};
   // Number of neighbours of each lattice site. Imposed by choice of lattice
   int n_edges{};
+  // Scratch space holding the energy of every state of a site, used by the
+  // heat-bath moves
+  vec1d site_state_energies{};
+  // Scratch space holding the candidate sites of a multiple-try move and the
+  // energy change of moving the particle to each of them
+  vec1i trial_sites{};
+  vec1d trial_energies{};
+  // Energy changes of the single-site moves met so far
+  delta_e_cache_struct delta_e_cache{};
+  // Energy of every site, for the energy-biased selection of particles
+  site_energy_field_struct site_energy_field{};
 };
 
 void initialize_interactions(state_struct& state,
@@ -47,6 +100,13 @@ double get_contact_energy(state_struct& state,
                           int site2,
                           interactions_struct& interactions,
                           geometry_space::Geometry& geometry);
+// Same, when the bond from site1 to site2 is already known
+double get_contact_energy(state_struct& state,
+                          int site1,
+                          int site2,
+                          int bond,
+                          interactions_struct& interactions,
+                          geometry_space::Geometry& geometry);
 
 // Get total energy of a given site, which is the sum of contact energies with
 // its neighbours
@@ -55,6 +115,73 @@ double get_site_energy(state_struct& state,
                        geometry_space::Geometry& geometry,
                        int site_index);
 
+// Fill state_energies with the energy that site_index would have in each
+// one-particle state (orientation + n_orientations * type), given the current
+// state of its neighbours
+void get_site_state_energies(state_struct& state,
+                             interactions_struct& interactions,
+                             geometry_space::Geometry& geometry,
+                             int site_index,
+                             vec1d& state_energies);
+
+// Energy change of site_index since it held a particle of orientation
+// old_orientation and type old_type, its current neighbours being unchanged.
+// Looked up in the energy change cache when it is enabled
+double get_site_change_energy(state_struct& state,
+                              interactions_struct& interactions,
+                              geometry_space::Geometry& geometry,
+                              int site_index,
+                              int old_orientation,
+                              int old_type);
+
+// Allocate the energy change cache with n_slots slots, rounded up to a power
+// of two. No cache is used if n_slots is 0 or if the keys of this lattice do
+// not fit in 64 bits
+void initialize_delta_e_cache(state_struct& state,
+                              interactions_struct& interactions,
+                              geometry_space::Geometry& geometry,
+                              int n_slots);
+
+// Forget the cached energy changes, which must be done when the couplings
+// change
+void clear_delta_e_cache(interactions_struct& interactions);
+
+// Print the hit rate and memory of the energy change cache
+void print_delta_e_cache_statistics(interactions_struct& interactions);
+
+// Recompute the energy and the selection weight of every site. Does nothing
+// unless the field is enabled. Needed whenever the configuration or the
+// couplings change other than through the moves
+void initialize_site_energy_field(state_struct& state,
+                                  interactions_struct& interactions,
+                                  geometry_space::Geometry& geometry);
+
+// Selection weight of a site of the given energy, zero if the site is empty
+double get_site_weight(state_struct& state,
+                       const site_energy_field_struct& field,
+                       int site_index,
+                       double site_energy);
+
+// Fill the changed sites of the energy field with site_1, site_2 (if not -1)
+// and their neighbours, with their energies in the current configuration
+void get_changed_site_energies(state_struct& state,
+                               interactions_struct& interactions,
+                               geometry_space::Geometry& geometry,
+                               int site_1,
+                               int site_2 = -1);
+
+// Write the changed sites into the energy field
+void commit_site_energies(state_struct& state,
+                          interactions_struct& interactions);
+
+// Update the energy field after an accepted move of site_1 and site_2 (if
+// not -1). Does nothing unless the field is enabled
+void update_site_energies(state_struct& state,
+                          interactions_struct& interactions,
+                          geometry_space::Geometry& geometry,
+                          int site_1,
+                          int site_2 = -1);
+
 // Get total energy of the system
 double get_energy(state_struct& state,
                   interactions_struct& interactions,
@@ -0,0 +1,93 @@
+#ifndef PARTICLES_LOCKSTEP_HEADER_H
+#define PARTICLES_LOCKSTEP_HEADER_H
+
+/**
+ * Lockstep update of several replicas (lanes) of the same lattice.
+ *
+ * The site states of all lanes are interleaved by site, so that the states of
+ * a given site in every lane sit next to each other in memory. A sweep visits
+ * the same site and bonds in every lane at once: the neighbour indices are
+ * fetched once per bond, and the energy lookups and the Metropolis test are
+ * done in plain loops over the lanes, which the compiler can vectorise.
+ * Acceptance is decided per lane, and applied with a mask.
+ *
+ * Only the moves that keep the occupancy of the lattice unchanged (rotate and
+ * mutate) are available, so that every lane shares the same list of full
+ * sites. Lanes differ by their random numbers and, optionally, by their
+ * couplings (see model_parameters_struct::replica_couplings).
+ */
+
+#include "geometry.h"
+#include "particles_interactions.h"
+#include "particles_parameters.h"
+#include "particles_state.h"
+
+#include <random>
+#include <vector>
+
+#include "vector_utils.h"
+
+namespace particles_space {
+
+struct lockstep_struct {
+  // Number of replicas updated together
+  int n_lanes {};
+  int n_sites {};
+  int n_neighbours {};
+  int n_orientations {};
+  int n_types {};
+  // Number of one-particle states, n_orientations * n_types
+  int n_states {};
+  // Probability that a move is a rotation rather than a mutation
+  double rotate_proba {1.0};
+  // Site index of every row-major index, as in state_struct
+  vec1i site_of_row_major {};
+  // Site states, interleaved by site: entry site * n_lanes + lane
+  vec1i types {};
+  vec1i orientations {};
+  // Full sites, shared by all the lanes
+  vec1i full_sites {};
+  // 1 if a site is full, 0 otherwise
+  vec1i occupied {};
+  // Face presented through a bond: entry bond * n_orientations + orientation
+  vec1i bond_faces {};
+  // Opposite bond of each bond
+  vec1i opposite_bonds {};
+  // Couplings of every lane, one flattened matrix after the other
+  vec1d couplings {};
+  // Current energy of every lane
+  vec1d energies {};
+  // Random number generators: one for the choices shared by all the lanes
+  // (site and move type), and one per lane for the proposals and acceptance
+  EngineType shared_rng {};
+  std::vector<EngineType> lane_rngs {};
+};
+
+// Create n_lanes copies of the current state of the system. If
+// parameters.replica_couplings is not empty, it must contain n_lanes coupling
+// matrices, one per lane. Otherwise every lane uses the model couplings.
+void initialize_lockstep(lockstep_struct& lockstep,
+                         int n_lanes,
+                         state_struct& state,
+                         interactions_struct& interactions,
+                         model_parameters_struct& parameters,
+                         geometry_space::Geometry& geometry);
+
+// Perform n_sites rotate or mutate attempts in every lane at temperature T
+void update_lockstep(lockstep_struct& lockstep,
+                     geometry_space::Geometry& geometry,
+                     double T);
+
+// Energy of a lane, computed from scratch
+double get_lockstep_energy(lockstep_struct& lockstep,
+                           geometry_space::Geometry& geometry,
+                           int lane);
+
+// Save the state of a lane with the same format as save_state
+void save_lockstep_state(lockstep_struct& lockstep,
+                         int lane,
+                         std::string& state_output);
+
+}  // namespace particles_space
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <limits>
 #include <random>
 
 #include <json.hpp>
@@ -30,6 +31,9 @@ enum mc_moves
   rotate,
   mutate,
   rotate_and_swap_w_empty,
+  heat_bath_rotate,
+  heat_bath_mutate,
+  insert_remove,
   n_enum_moves
 };
 
@@ -38,13 +42,51 @@ static const inline std::array<std::string, n_enum_moves> mc_moves_str {
     "swap_full_full",
     "rotate",
     "mutate",
-    "rotate_and_swap_w_empty"};
+    "rotate_and_swap_w_empty",
+    "heat_bath_rotate",
+    "heat_bath_mutate",
+    "insert_remove"};
 
 // User-supplied array of probabilities of selecting each type of move during
 // lattice update
 using move_probas_arr =
     std::array<double, static_cast<int>(mc_moves::n_enum_moves)>;
 
+/**
+ * Umbrella bias on the size n of the largest cluster, set by the umbrella
+ * sampling engine and added to the energy change of a move in
+ * is_move_accepted:
+ *   U(n) = spring / 2 * (n - center)^2
+ * Moves which take n further away from [window_min, window_max] are
+ * rejected. Only the moves which fill or empty a site can change n: they
+ * update the clusters tracked in the state and store the size after the move
+ * in proposed_size before is_move_accepted is called, which then updates
+ * current_size.
+ */
+struct umbrella_struct
+{
+  bool option {false};
+  double center {};
+  double spring {};
+  int window_min {0};
+  int window_max {std::numeric_limits<int>::max()};
+  int current_size {};
+  int proposed_size {};
+};
+
+/**
+ * Creutz demon of the microcanonical mode: a move is accepted if and only if
+ * the demon energy covers its energy change, which is then taken from (or
+ * given to) the demon, so that the energy of the system plus that of the
+ * demon is conserved. The acceptance draws no random number and evaluates no
+ * exponential.
+ */
+struct demon_struct
+{
+  bool option {false};
+  double energy {0.0};
+};
+
 /*
  * Definitions required for the public routines of the model class
  */
@@ -60,9 +102,10 @@ using move_probas_arr =
  *                     possible pair of faces
  * rng               - random number generator
  * initialize_option - option string for choosing initialization function
- *                     current options are "from_file", "random"
- * state_input       - if initialize_option is set to "from_file", this
- *                     string contains the location of the input structure
+ *                     current options are "from_file", "random", "warm_start"
+ * state_input       - if initialize_option is set to "from_file" or
+ *                     "warm_start", this string contains the location of the
+ *                     input structure
  * move_probas       - user-supplied array of various moves' probabilities of
  *                     being picked during update
  * e_av_option      - Set to true to record average energies
@@ -73,6 +116,36 @@ using move_probas_arr =
  *                    Too scared to remove it though!
  * e_record_option  - Set to true to record energy after each system update
  * e_record_output  - Location where to output the energy records
+ * replica_couplings - Optional list of flattened couplings, one per replica,
+ *                     for the engines that simulate several Hamiltonians
+ * best_state_option - Optional, set to true to keep a copy of the
+ *                     lowest-energy configuration met during the run
+ * best_state_threshold - Optional, the copy is only refreshed when the
+ *                     energy goes below the last copied one by more than
+ *                     this amount
+ * chemical_potentials - Optional, chemical potential of each particle type,
+ *                     used by the exact transfer-matrix solver and by the
+ *                     grand-canonical insert_remove moves, which require it
+ * swap_empty_full_tries - Optional, number of candidate empty sites drawn
+ *                     by every swap_empty_full move (multiple-try
+ *                     Metropolis). Defaults to 1, a single random destination
+ * delta_e_cache_size - Optional, number of slots of the cache of the energy
+ *                     changes of rotations and mutations, rounded up to a
+ *                     power of two. Defaults to 0, no cache
+ * site_energy_bias  - Optional, the particles of the rotations and mutations
+ *                     are picked with a probability proportional to
+ *                     exp(site_energy_bias * site energy). Defaults to 0,
+ *                     uniform picks
+ * prefetch_option   - Optional, set to true to draw the particles of the next
+ *                     proposals a few moves ahead and prefetch their
+ *                     neighbourhoods
+ * sparse_option     - Optional, set to true to store only the full sites,
+ *                     in hash tables, and compute neighbours from the lattice
+ *                     coordinates, for dilute systems in large boxes
+ * n_accepted_moves  - number of moves which changed the state of the system
+ *                     since the start of the run. Not an input.
+ * umbrella          - bias on the size of the largest cluster. Not an input.
+ * demon             - Creutz demon of the microcanonical mode. Not an input.
  **/
 struct model_parameters_struct
 {
@@ -90,6 +163,18 @@ struct model_parameters_struct
   std::string state_av_output {};
   bool e_record_option {false};
   std::string e_record_output {};
+  vec2d replica_couplings {};
+  bool best_state_option {false};
+  double best_state_threshold {0.0};
+  vec1d chemical_potentials {};
+  int swap_empty_full_tries {1};
+  int delta_e_cache_size {0};
+  double site_energy_bias {0.0};
+  bool prefetch_option {false};
+  bool sparse_option {false};
+  long n_accepted_moves {0};
+  umbrella_struct umbrella {};
+  demon_struct demon {};
 };
 
 std::ostream &operator<<(std::ostream &out, model_parameters_struct &params);
@@ -0,0 +1,75 @@
+#ifndef PARTICLES_QUENCH_HEADER_H
+#define PARTICLES_QUENCH_HEADER_H
+
+/**
+ * Zero-temperature quench of a configuration of particles.
+ *
+ * The best downhill move starting from every full site is kept in a priority
+ * queue ranked by energy change, and the best move of the whole lattice is
+ * applied until no downhill move remains. A move only changes the moves
+ * available to the sites up to two bonds away from the sites it modified, so
+ * only these are evaluated again; entries of the queue evaluated before the
+ * move are recognised with a per-site stamp and skipped.
+ *
+ * The moves considered are the local versions of the MC moves enabled in
+ * move_probas:
+ * - rotate, heat_bath_rotate:  change of orientation of the particle
+ * - mutate, heat_bath_mutate:  change of type of the particle
+ * - swap_empty_full:           hop of the particle to an empty neighbouring
+ *                              site
+ * - rotate_and_swap_w_empty:   hop with a change of orientation
+ * - swap_full_full:            exchange of two neighbouring particles
+ */
+
+#include "geometry.h"
+#include "particles_interactions.h"
+#include "particles_parameters.h"
+#include "particles_state.h"
+
+#include "vector_utils.h"
+
+namespace particles_space {
+
+// A move starting from a full site
+struct quench_move_struct {
+  // Energy change caused by the move
+  double delta_e {};
+  // Full site the move starts from
+  int site {};
+  // Neighbouring site the particle hops to or is exchanged with, -1 if the
+  // particle stays in place
+  int partner {-1};
+  // Orientation + n_orientations * type of the particle after the move
+  int new_state {};
+  // Stamp of site when the move was evaluated
+  int stamp {};
+};
+
+// Ordering of the priority queue: lowest energy change first
+struct quench_move_compare {
+  bool operator()(const quench_move_struct& move_1,
+                  const quench_move_struct& move_2) const
+  {
+    return move_1.delta_e > move_2.delta_e;
+  }
+};
+
+// Apply downhill moves to the system until it reaches a local energy minimum.
+// Returns the number of moves applied.
+long quench_system(state_struct& state,
+                   interactions_struct& interactions,
+                   model_parameters_struct& parameters,
+                   geometry_space::Geometry& geometry);
+
+// Best allowed move starting from the full site site_index. Its delta_e is 0
+// if no move lowers the energy.
+quench_move_struct get_best_site_move(state_struct& state,
+                                      interactions_struct& interactions,
+                                      model_parameters_struct& parameters,
+                                      geometry_space::Geometry& geometry,
+                                      int site_index,
+                                      vec1d& state_energies);
+
+}  // namespace particles_space
+
+#endif
@@ -21,9 +21,13 @@ namespace particles_space
 // e_record - energy after each lattice update
 // e_record - temperature after each lattice update. Can be re-derived, but more
 // convenient like this
+// best_energy - energy of the lowest-energy configuration met so far
+// best_sites  - copy of the site contents in that configuration
 struct records_struct
 {
   vec1d e_records {};
+  double best_energy {};
+  SiteVector best_sites {};
 };
 
 void update_records(model_parameters_struct& parameters,
@@ -38,6 +42,37 @@ void save_records(model_parameters_struct& parameters,
  * End of the required definitions for the model class
  */
 
+// Take the current configuration as the best one
+void initialize_best_state(state_struct& state,
+                           interactions_struct& interactions,
+                           records_struct& records);
+
+// Copy the current configuration if its energy is lower than the best one by
+// more than parameters.best_state_threshold. Cheap enough to be checked after
+// every move.
+inline void update_best_state(model_parameters_struct& parameters,
+                              state_struct& state,
+                              interactions_struct& interactions,
+                              records_struct& records)
+{
+  if (parameters.best_state_option
+      and interactions.energy
+          < records.best_energy - parameters.best_state_threshold)
+  {
+    initialize_best_state(state, interactions, records);
+  }
+}
+
+// Save the best configuration with the same format as save_state
+void save_best_state(state_struct& state,
+                     records_struct& records,
+                     std::string& state_output);
+
+// Replace the current configuration by the best one
+void restore_best_state(state_struct& state,
+                        interactions_struct& interactions,
+                        records_struct& records);
+
 }  // namespace particles_space
 
 #endif
@@ -9,6 +9,7 @@
 
 #include "particles_parameters.h"
 #include "geometry.h"
+#include "site_hash_map.h"
 
 #include <fstream>
 #include <functional>
@@ -39,50 +40,83 @@ struct state_struct;
  * particle types and the other of particle orientations. Orientation -1 will
  * always be empty. Created along with the state according to one of the options
  * which must be supplied in the config file.
+ * A sparse SiteVector only stores the full sites, in a hash table giving their
+ * one-particle state, so that its memory scales with the number of particles.
+ * Empty sites then always have type 0.
  */
 class SiteVector {
 public:
   SiteVector() = default;
   /**
    * Parameters:
-   * - option: string which can take 2 values, "from_file", in which case state
-   *   is initialized from the contents of a file with appropriate format, and
-   *   "random", in which case the state is randomly initialized.
+   * - option: string which can take 3 values, "from_file", in which case state
+   *   is initialized from the contents of a file with appropriate format,
+   *   "random", in which case the state is randomly initialized, and
+   *   "warm_start", in which case the state is read from a file and particles
+   *   are added or removed at random to match the particle numbers.
    * - state: state_struct class instance
    * - parameters: appropriate model_parameters_struct instance
    * **/
   SiteVector(std::string& option,
              state_struct& state,
              model_parameters_struct& parameters);
+  // Build directly from arrays of particle types and orientations
+  SiteVector(const vec1i& types, const vec1i& orientations, int n_orientations)
+      : types_m {types}
+      , orientations_m {orientations}
+      , n_orientations_m {n_orientations} {};
 
   // ----- SIMPLE GETTERS AND SETTERS -----
   int get_type(const int site_index) const
   {
+    if (sparse_m) {
+      int site_state {site_states_m.get(site_index)};
+      return site_state == -1 ? 0 : site_state / n_orientations_m;
+    }
     return types_m[static_cast<std::size_t>(site_index)];
   };
   int get_orientation(const int site_index) const
   {
+    if (sparse_m) {
+      int site_state {site_states_m.get(site_index)};
+      return site_state == -1 ? -1 : site_state % n_orientations_m;
+    }
     return orientations_m[static_cast<std::size_t>(site_index)];
   };
   bool is_empty(const int site_index) const
   {
+    if (sparse_m) {
+      return !site_states_m.contains(site_index);
+    }
     return orientations_m[static_cast<std::size_t>(site_index)] == -1;
   };
   int get_state(const int site_index) const;
   void set_type(const int site_index, const int new_type)
   {
+    if (sparse_m) {
+      set_site(site_index, new_type, get_orientation(site_index));
+      return;
+    }
     types_m[static_cast<std::size_t>(site_index)] = new_type;
   }
   void set_orientation(const int site_index, const int new_orientation)
   {
+    if (sparse_m) {
+      set_site(site_index, get_type(site_index), new_orientation);
+      return;
+    }
     orientations_m[static_cast<std::size_t>(site_index)] = new_orientation;
   }
   void set_site(const int site_index,
                 const int new_type,
                 const int new_orientation)
   {
-    set_type(site_index, new_type);
-    set_orientation(site_index, new_orientation);
+    if (sparse_m) {
+      set_sparse_site(site_index, new_type, new_orientation);
+      return;
+    }
+    types_m[static_cast<std::size_t>(site_index)] = new_type;
+    orientations_m[static_cast<std::size_t>(site_index)] = new_orientation;
   }
 
   /**
@@ -90,6 +124,24 @@ public:
    * `index1` and `index2`
    * **/
   void swap_sites(const int index1, const int index2);
+  // Prefetch the type and orientation of a site
+  void prefetch_site(const int site_index) const
+  {
+    if (sparse_m) {
+      site_states_m.prefetch(site_index);
+      return;
+    }
+    array_space::prefetch_address(&types_m[static_cast<std::size_t>(site_index)]);
+    array_space::prefetch_address(
+        &orientations_m[static_cast<std::size_t>(site_index)]);
+  }
+
+  // ----- SPARSE STORAGE -----
+  bool is_sparse() const { return sparse_m; };
+  // Move the full sites to the hash table and free the per-site vectors
+  void make_sparse();
+  // Indices of the full sites of a sparse SiteVector, in increasing order
+  vec1i get_full_sites() const { return site_states_m.get_sites(); };
   friend std::ostream& operator<<(std::ostream& out, state_struct& state);
 
 private:
@@ -99,6 +151,14 @@ private:
   vec1i orientations_m{};
   // Number of orientations our particles can take
   int n_orientations_m{};
+  // Whether the state is stored in site_states_m instead of the vectors
+  bool sparse_m{false};
+  // One-particle state (as given by get_state) of every full site
+  site_hash_space::SiteHashMap site_states_m{};
+  // Store a particle in the hash table, or remove it if new_orientation is -1
+  void set_sparse_site(const int site_index,
+                       const int new_type,
+                       const int new_orientation);
 };
 
 class FullEmptySites
@@ -107,12 +167,18 @@ class FullEmptySites
    * Class which keeps track of which lattice sites are full and empty.
    * To be updated whenever we swap full and empty sites.
    * Useful to pick a full/empty site at random.
+   * If the SiteVector is sparse, only the full sites are listed, and random
+   * empty sites are drawn by rejection among all the sites.
    */
 public:
   FullEmptySites() = default;
   FullEmptySites(state_struct &state);
   void update_after_swap(const int initially_full_index,
                          const int initially_empty_index);
+  // Move a site to the list of full sites after a particle was inserted on
+  // it, or to the list of empty sites after its particle was removed
+  void update_after_insertion(const int site_index);
+  void update_after_removal(const int site_index);
   // ----- SIMPLE GETTERS -----
   int get_n_full_sites()
   {
@@ -120,15 +186,45 @@ public:
   };
   int get_n_empty_sites()
   {
+    if (sparse_m) {
+      return n_sites_m - get_n_full_sites();
+    }
     return static_cast<int>(empty_sites_indices_m.size());
   };
+  // k-th entry of the list of full sites
+  int get_full_site(std::size_t k) const
+  {
+    return static_cast<int>(full_sites_indices_m[k]);
+  };
 
   // ----- RANDOM SITE GETTERS -----
+  // Random full sites are taken from the positions drawn ahead first, if any
   int get_random_full_site(model_parameters_struct& parameters);
   int get_random_empty_site(model_parameters_struct& parameters);
+
+  // ----- POSITIONS DRAWN AHEAD -----
+  // Uniform positions in the list of full sites can be drawn before they are
+  // needed, so that the neighbourhoods of the next proposals are prefetched
+  // while the current one is evaluated. They stay uniform and independent of
+  // the moves made in between as long as the number of full sites does not
+  // change, and are dropped otherwise.
+  void draw_full_site_ahead(model_parameters_struct& parameters);
+  std::size_t get_n_full_sites_ahead() const
+  {
+    return full_sites_ahead_m.size();
+  };
+  // Full site at the k-th position drawn ahead, oldest first
+  int get_full_site_ahead(std::size_t k) const
+  {
+    return static_cast<int>(full_sites_indices_m[full_sites_ahead_m[k]]);
+  };
+  void clear_full_sites_ahead() { full_sites_ahead_m.clear(); };
   friend std::ostream& operator<<(std::ostream& out, state_struct& state);
 
 private:
+  // Remove site_index from the list from, filling the hole with the last
+  // entry, and append it to the list to
+  void move_site(const int site_index, vec1s& from, vec1s& to);
   // Vector of full site indices
   vec1s full_sites_indices_m{};
   // Vector of empty site indices
@@ -136,6 +232,84 @@ private:
   // map of each site index to the corresponding coefficient in the
   // full_/empty_sites arrays
   vec1s site_inds_to_full_empty_m{};
+  // Positions in the list of full sites drawn ahead, oldest first
+  vec1s full_sites_ahead_m{};
+  // Sparse mode: number of sites, and position in full_sites_indices_m of
+  // each full site, which replaces site_inds_to_full_empty_m
+  bool sparse_m{false};
+  int n_sites_m{};
+  site_hash_space::SiteHashMap full_positions_m{};
+};
+
+class ClusterTracker
+{
+  /*
+   * Class which labels the clusters of full sites and keeps their sizes, so
+   * that the size of the largest cluster is known without searching the
+   * whole lattice. To be updated whenever a site is filled or emptied: only
+   * the clusters touching that site are visited. Filling a site merges the
+   * smaller neighbouring clusters into the largest one. Emptying a site
+   * searches the fragments of its cluster from its neighbours in turns, and
+   * stops as soon as all of them but one are complete, so that the largest
+   * fragment is usually not visited.
+   * If the SiteVector is sparse, the labels of the full sites are stored in a
+   * hash table.
+   */
+public:
+  ClusterTracker() = default;
+  ClusterTracker(state_struct& state, geometry_space::Geometry& geometry);
+  // Update the labels after the site was filled, or after it was emptied
+  void update_after_insertion(geometry_space::Geometry& geometry,
+                              const int site_index);
+  void update_after_removal(geometry_space::Geometry& geometry,
+                            const int site_index);
+  int get_largest_cluster_size() const { return largest_size_m; };
+
+private:
+  // Label of the cluster of a site, -1 if the site is empty
+  int get_label(const int site_index) const
+  {
+    if (sparse_m) {
+      return labels_sparse_m.get(site_index);
+    }
+    return labels_m[static_cast<std::size_t>(site_index)];
+  };
+  void set_label(const int site_index, const int label);
+  // Unused label, with a cluster of size 0
+  int get_new_label();
+  // Give label to all the sites of the cluster containing site_index, which
+  // are labelled old_label
+  void relabel_cluster(geometry_space::Geometry& geometry,
+                       const int site_index,
+                       const int old_label,
+                       const int label);
+  // Count a cluster of size n in size_counts_m, or stop counting it
+  void add_cluster_size(const int n);
+  void remove_cluster_size(const int n);
+
+  // Label of every site, -1 if empty
+  vec1i labels_m{};
+  // Sparse mode: label of every full site
+  bool sparse_m{false};
+  site_hash_space::SiteHashMap labels_sparse_m{};
+  // Size of the cluster with each label. The labels of the clusters which
+  // were merged or emptied are reused
+  vec1i cluster_sizes_m{};
+  vec1i free_labels_m{};
+  // Number of clusters of each size, and largest size with a nonzero count
+  vec1i size_counts_m{};
+  int largest_size_m{0};
+  // Work arrays, kept to avoid reallocations: the distinct neighbouring
+  // sites or labels of the updated site, a stack of sites to visit, and for
+  // each search the sites it found, the number of them whose neighbours were
+  // visited, its temporary label and the search it was merged into (itself
+  // if none)
+  vec1i neighbours_m{};
+  vec1i stack_m{};
+  vec2i search_sites_m{};
+  vec1s search_heads_m{};
+  vec1i search_labels_m{};
+  vec1s search_parents_m{};
 };
 
 // Structure containing the characteristics of the state of the system
@@ -150,12 +324,19 @@ struct state_struct {
   int n_states{};
   // Number of lattice sites
   int n_sites{};
+  // Site index of every row-major index, used to read and write state files,
+  // which list the sites in row-major order. Empty if the sites are stored in
+  // row-major order
+  vec1i site_of_row_major{};
   // Vector of the number of particles of each type
   vec1i n_particles{};
   // Class describing the state of each lattice site
   SiteVector lattice_sites{};
   // Class keeping track of which sites are full and which sites are empty
   FullEmptySites full_empty_sites{};
+  // Class keeping track of the clusters of full sites. Only built and updated
+  // under an umbrella bias
+  ClusterTracker clusters{};
 };
 
 // Initialize the structural properties of the system, depending on the type
@@ -190,6 +371,34 @@ void initialize_state_from_file(vec1i& types,
                                 vec1i& orientations,
                                 model_parameters_struct& parameters);
 
+// Initialize state from the final structure of another run, in the file
+// specified in the model_parameters_struct object, then remove particles from
+// random sites and place new ones (with random orientations) on random empty
+// sites until every type has the number of particles given in parameters.
+// Particles whose type does not exist in this run are removed.
+void initialize_state_warm_start(vec1i& types,
+                                 vec1i& orientations,
+                                 state_struct& state,
+                                 model_parameters_struct& parameters);
+
+// Read the particle types and orientations from a file written by save_state
+void read_state_file(vec1i& types,
+                     vec1i& orientations,
+                     const std::string& state_input);
+
+// Reorder per-site values listed in row-major order into the order in which
+// the sites are stored. Does nothing if site_of_row_major is empty
+void reorder_from_row_major(const vec1i& site_of_row_major, vec1i& values);
+
+// Replace the current state of the lattice by the one stored in the file
+// "state_input", written by save_state. Particle numbers are recounted from
+// the file.
+void load_state(state_struct& state, const std::string& state_input);
+
+// Replace the contents of every lattice site by those of sites, rebuilding
+// the lists of full and empty sites and recounting the particles
+void reset_state_sites(state_struct& state, const SiteVector& sites);
+
 // Initialize a state with a set random of particles uniformly distributed on
 // the lattice, with a given number of particles given in parameters
 // types and orientations are the arrays being filled
@@ -198,10 +407,33 @@ void initialize_state_random_fixed_particle_numbers(
     vec1i& orientations,
     state_struct& state,
     model_parameters_struct& parameters);
+// Same for a sparse state: the one-particle state of each particle is stored
+// in site_states, and empty sites are found by rejection
+void initialize_sparse_state_random_fixed_particle_numbers(
+    site_hash_space::SiteHashMap& site_states,
+    state_struct& state,
+    model_parameters_struct& parameters);
+
+// Number of particles in the largest cluster, i.e. set of full sites
+// connected through bonds between neighbouring full sites
+int get_largest_cluster_size(state_struct& state,
+                             geometry_space::Geometry& geometry);
 
 // Exchange the states of site_1 and site_2, updating both the SiteVector and
 // FullEmptySites objects. site_1 and site_2 can be either empty or full.
 void swap_sites(state_struct& state, int site_1_index, int site_2_index);
 
+// Place a particle on an empty site, or remove the particle of a full site,
+// updating the SiteVector, FullEmptySites and the particle numbers
+void insert_particle(state_struct& state,
+                     int site_index,
+                     int type,
+                     int orientation);
+void remove_particle(state_struct& state, int site_index);
+
+// Change the type of the particle of a full site, updating the particle
+// numbers
+void set_particle_type(state_struct& state, int site_index, int new_type);
+
 }  // namespace particles_space
 #endif
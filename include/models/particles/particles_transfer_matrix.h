@@ -0,0 +1,91 @@
+#ifndef PARTICLES_TRANSFER_MATRIX_HEADER_H
+#define PARTICLES_TRANSFER_MATRIX_HEADER_H
+
+/**
+ * Exact thermodynamics of particles on an infinite chain, or on an infinite
+ * strip of the square or triangular lattice whose width is the ly of the
+ * lattice (periodic across the strip, as in the simulations).
+ *
+ * A column of the strip holds width sites, and its state c lists the
+ * one-site states of these sites. The transfer matrix between consecutive
+ * columns c and c' is
+ *   W(c, c') = exp(-(E(c, c') - mu . (N(c) + N(c')) / 2) / T),
+ * where E(c, c') holds the contacts between the two columns and half of the
+ * contacts inside each of them, all measured with the Geometry bond
+ * permutations and the couplings, and N(c) counts the particles of each type
+ * in c. Per column, the free energy is -T ln(lambda) with lambda the largest
+ * eigenvalue of W, and the averages follow from its left and right
+ * eigenvectors l and r:
+ *   <E> = sum_{c, c'} l(c) W(c, c') E(c, c') r(c') / (lambda l.r).
+ *
+ * With the optional chemical_potentials model parameter the particles are in
+ * the grand-canonical ensemble, and the free energy is the grand potential.
+ * Otherwise the lattice must be fully occupied and only the orientations and
+ * types of the particles fluctuate.
+ */
+
+#include "geometry.h"
+#include "particles_interactions.h"
+#include "particles_parameters.h"
+#include "particles_state.h"
+
+#include <functional>
+
+#include "vector_utils.h"
+
+namespace particles_space {
+
+struct transfer_matrix_struct {
+  // Number of sites in a column
+  int width {};
+  // Number of states of one site, and of a column
+  int n_site_states {};
+  int n_column_states {};
+  // Type and orientation of each one-site state. Orientation -1 is empty
+  vec1i site_types {};
+  vec1i site_orientations {};
+  // Chemical potential of each type, empty for a full lattice
+  vec1d chemical_potentials {};
+  // E(c, c'), stored at c * n_column_states + c'
+  vec1d pair_energies {};
+  // Number of particles of each type in each column state
+  vec2d column_particles {};
+  // Weights W(c, c') at the current temperature, divided by their largest
+  // value exp(log_scale)
+  vec1d weights {};
+  double log_scale {};
+  // Right and left eigenvectors, kept as starting guesses for the next
+  // temperature
+  vec1d right {};
+  vec1d left {};
+};
+
+// Build the energies of the transfer matrix of the lattice of geometry
+void initialize_transfer_matrix(transfer_matrix_struct& transfer_matrix,
+                                state_struct& state,
+                                interactions_struct& interactions,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry);
+
+// Fill the weights at temperature T, and return the logarithm of their
+// largest eigenvalue, which is computed along with its eigenvectors
+double solve_transfer_matrix(transfer_matrix_struct& transfer_matrix,
+                             double T);
+
+// Average of column_quantity(c, c') in the eigenvectors of the last solve
+double get_transfer_matrix_average(
+    transfer_matrix_struct& transfer_matrix,
+    double log_eigenvalue,
+    const std::function<double(int, int)>& column_quantity);
+
+// One line per temperature, with the free energy, energy, heat capacity and
+// density of each type, all per site
+vec2d get_exact_thermodynamics(state_struct& state,
+                               interactions_struct& interactions,
+                               model_parameters_struct& parameters,
+                               geometry_space::Geometry& geometry,
+                               const vec1d& temperatures);
+
+}  // namespace particles_space
+
+#endif
@@ -25,11 +25,13 @@ using json = nlohmann::json;
 // state        - configuration of the system before the update
 // interactions - energetics of the system before the update
 // parameters   - used to access random number generator (parameters.rng)
+// records      - keeps the best configuration if parameters.best_state_option
 // T            - annealing temperature (not the same as T_model!)
 void update_system(state_struct& state,
                    interactions_struct& interactions,
                    model_parameters_struct& parameters,
                    geometry_space::Geometry& geometry,
+                   records_struct& records,
                    double T);
 
 /*
@@ -42,6 +44,45 @@ void update_system(state_struct& state,
 
 mc_moves pick_random_move(model_parameters_struct &parameters);
 
+// Number of positions of full sites kept drawn ahead by the prefetching
+// pipeline, including the one of the current proposal
+constexpr std::size_t n_proposals_ahead {4};
+
+// Keep n_proposals_ahead random full sites drawn, and prefetch them in three
+// stages: entry of the list of full sites when drawn, then neighbour indices,
+// then states of the site and its neighbours by the time it is the next
+// proposal
+void prefetch_next_proposals(state_struct& state,
+                             model_parameters_struct& parameters,
+                             geometry_space::Geometry& geometry);
+
+// Particle of a rotation or mutation: picked uniformly, or with the weights of
+// the site energy field when it is enabled
+int pick_single_site_particle(state_struct& state,
+                              model_parameters_struct& parameters,
+                              interactions_struct& interactions);
+
+// Hastings correction of the energy-biased picks of pick_single_site_particle:
+// logarithm of the probability of picking site_index after the move (already
+// applied) over that before. Fills the changed sites of the energy field, to
+// be committed if the move is accepted. Returns 0 if the field is disabled
+double get_selection_log_ratio(state_struct& state,
+                               interactions_struct& interactions,
+                               geometry_space::Geometry& geometry,
+                               int site_index);
+
+// Whether the lattice holds the full and empty sites chosen_move acts on.
+// With grand-canonical moves the lattice can become completely empty or full.
+bool is_move_possible(mc_moves chosen_move, state_struct& state);
+
+// Attempt a move of kind chosen_move, and return the energy change it caused
+double attempt_move(mc_moves chosen_move,
+                    state_struct& state,
+                    model_parameters_struct& parameters,
+                    interactions_struct& interactions,
+                    geometry_space::Geometry& geometry,
+                    double T);
+
 std::size_t select_random_full_index(state_struct &state,
                                      model_parameters_struct &parameters);
 std::size_t select_random_empty_index(state_struct &state,
@@ -78,6 +119,37 @@ double attempt_swap_empty_full(state_struct& state,
                                interactions_struct& interactions,
                                geometry_space::Geometry& geometry,
                                double T);
+
+/*
+ * Multiple-try Metropolis version of attempt_swap_empty_full: the particle of
+ * a random full site is offered n_tries random empty sites at once, one of
+ * which is chosen with its Boltzmann weight. The move is accepted with
+ * probability min(1, W / W'), where W is the total weight of the candidates
+ * and W' that of n_tries - 1 random empty sites drawn from the new
+ * configuration plus the original site, all seen from the new position of the
+ * particle.
+ */
+double attempt_multiple_try_swap_empty_full(state_struct& state,
+                                            model_parameters_struct& parameters,
+                                            interactions_struct& interactions,
+                                            geometry_space::Geometry& geometry,
+                                            double T);
+
+// Energy change of moving the particle of full_site to each of the n_trials
+// first sites of interactions.trial_sites, written to
+// interactions.trial_energies
+void get_trial_energies(int full_site,
+                        std::size_t n_trials,
+                        state_struct& state,
+                        interactions_struct& interactions,
+                        geometry_space::Geometry& geometry);
+
+// Logarithm of the total Boltzmann weight of the n_trials first energies of
+// trial_energies
+double get_log_trial_weight(const vec1d& trial_energies,
+                            std::size_t n_trials,
+                            double T);
+
 double attempt_swap_full_full(state_struct& state,
                               model_parameters_struct& parameters,
                               interactions_struct& interactions,
@@ -99,10 +171,97 @@ double attempt_rotate_and_swap_w_empty(state_struct& state,
                                        geometry_space::Geometry& geometry,
                                        double T);
 
+/*
+ * Heat-bath moves: the energies of all the candidate states of a random full
+ * site are computed in one pass over its neighbours, and the new state is
+ * sampled directly from their Boltzmann distribution, so that no move is ever
+ * rejected. heat_bath_rotate samples the orientation of the particle at fixed
+ * type, heat_bath_mutate samples its orientation and type together.
+ */
+double attempt_heat_bath_rotate(state_struct& state,
+                                model_parameters_struct& parameters,
+                                interactions_struct& interactions,
+                                geometry_space::Geometry& geometry,
+                                double T);
+double attempt_heat_bath_mutate(state_struct& state,
+                                model_parameters_struct& parameters,
+                                interactions_struct& interactions,
+                                geometry_space::Geometry& geometry,
+                                double T);
+
+/*
+ * Grand-canonical move: with equal probabilities, insert a particle in a
+ * random state (type and orientation) on a random empty site, or remove a
+ * random particle. With N particles, N_e empty sites and n_states states per
+ * particle, an insertion of a particle of type t is accepted with probability
+ *   min(1, N_e n_states / (N + 1) exp(-(delta_e - mu_t) / T)),
+ * and a removal with
+ *   min(1, N / ((N_e + 1) n_states) exp(-(delta_e + mu_t) / T)),
+ * where mu_t is the chemical potential of type t in the model parameters.
+ */
+double attempt_insert_remove(state_struct& state,
+                             model_parameters_struct& parameters,
+                             interactions_struct& interactions,
+                             geometry_space::Geometry& geometry,
+                             double T);
+
+// Chemical potential of type when the insert_remove moves are enabled, and 0
+// otherwise. Mutations, which change the type of a particle, include the
+// difference of chemical potentials in their acceptance.
+double get_chemical_potential(const model_parameters_struct& parameters,
+                              int type);
+
+// Sample a state among state_energies[first_state, first_state + n_candidates)
+// with probability proportional to its Boltzmann weight at temperature T
+int sample_heat_bath_state(const vec1d& state_energies,
+                           int first_state,
+                           int n_candidates,
+                           double T,
+                           model_parameters_struct& parameters);
+
 // Accept or reject a move associated with energy delta_e at temperature T
-// according to the Metropolis-Hastings rule
+// according to the Metropolis-Hastings rule, including the umbrella bias if
+// it is set, or with the Creutz demon if it is enabled
 bool is_move_accepted(double delta_e, double T,
                       model_parameters_struct &parameters);
+
+// Umbrella bias of a largest cluster of size n, and distance from n to the
+// umbrella window
+double get_umbrella_bias(const umbrella_struct& umbrella, int n);
+int get_umbrella_window_distance(const umbrella_struct& umbrella, int n);
+
+// Track the clusters of the state and set the umbrella sizes to the size of
+// its largest cluster. Does nothing unless the umbrella bias is set. Needed
+// whenever the configuration changes other than through the moves
+void initialize_umbrella_clusters(state_struct& state,
+                                  model_parameters_struct& parameters,
+                                  geometry_space::Geometry& geometry);
+
+// After the contents of site_1 and site_2 were exchanged, update the tracked
+// clusters if the umbrella bias is set and one of the sites was filled and
+// the other emptied. Moves which undo an exchange call it again. The same
+// after a particle was inserted on a site or removed from it
+void update_umbrella_clusters(state_struct& state,
+                              model_parameters_struct& parameters,
+                              geometry_space::Geometry& geometry,
+                              int site_1,
+                              int site_2);
+void update_umbrella_clusters(state_struct& state,
+                              model_parameters_struct& parameters,
+                              geometry_space::Geometry& geometry,
+                              int site);
+
+// Update the tracked clusters as above, and store the size of the largest
+// one in the umbrella proposed_size
+void set_umbrella_proposed_size(state_struct& state,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry,
+                                int site_1,
+                                int site_2);
+void set_umbrella_proposed_size(state_struct& state,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry,
+                                int site);
 } // namespace lattice_particles_space
 
 #endif
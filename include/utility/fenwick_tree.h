@@ -0,0 +1,50 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef FENWICK_TREE_HEADER_H
+#define FENWICK_TREE_HEADER_H
+
+#include <cstddef>
+
+#include "vector_utils.h"
+
+namespace fenwick_space {
+/*
+ * Fenwick (binary indexed) tree over non-negative weights, for weighted
+ * sampling of an index in O(log N) with O(log N) updates of single weights.
+ */
+class FenwickTree {
+public:
+  FenwickTree() = default;
+
+  // Rebuild the tree from a full set of weights, in O(N)
+  void assign(const vec1d& weights);
+
+  // Change the weight of index i. The tree is rebuilt from the weights after
+  // every size() changes, so that rounding errors do not accumulate
+  void set_weight(std::size_t i, double weight);
+
+  double get_weight(std::size_t i) const { return weights_m[i]; }
+  double get_total_weight() const { return total_m; }
+  std::size_t size() const { return weights_m.size(); }
+
+  // Index i such that the weights before i sum to at most u and the weights
+  // up to i sum to more than u, for u in [0, total weight). Indices of zero
+  // weight are never returned.
+  std::size_t sample(double u) const;
+
+private:
+  // Recompute the partial sums and the total from weights_m
+  void rebuild();
+
+  vec1d weights_m {};
+  // tree_m[k - 1] holds the sum of the weights of indices k - lowbit(k) to
+  // k - 1
+  vec1d tree_m {};
+  double total_m {0.0};
+  // Number of calls to set_weight since the last rebuild
+  std::size_t n_updates_m {0};
+};
+}  // namespace fenwick_space
+
+#endif
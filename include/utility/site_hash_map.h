@@ -0,0 +1,53 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef SITE_HASH_MAP_HEADER_H
+#define SITE_HASH_MAP_HEADER_H
+
+#include <cstddef>
+
+#include "vector_utils.h"
+
+namespace site_hash_space {
+/*
+ * Open-addressing hash map from non-negative site indices to non-negative
+ * values, with linear probing and Fibonacci hashing. Memory is proportional
+ * to the number of stored sites: the table doubles whenever it becomes half
+ * full. Removals shift the following entries back, so no tombstones are left.
+ */
+class SiteHashMap {
+public:
+  SiteHashMap() = default;
+
+  // Value stored for site, or -1 if the site is absent
+  int get(const int site) const;
+  bool contains(const int site) const { return get(site) != -1; }
+  // Store value (>= 0) for site, replacing any previous value
+  void set(const int site, const int value);
+  // Remove site, if present
+  void erase(const int site);
+  void clear();
+
+  std::size_t size() const { return n_entries_m; }
+  // Stored sites, in increasing order
+  vec1i get_sites() const;
+  // Prefetch the slot where the search for site starts
+  void prefetch(const int site) const;
+
+private:
+  // Slot where the search for site starts
+  std::size_t get_home_slot(const int site) const;
+  // Double the number of slots and insert the entries again
+  void grow();
+
+  // Site and value of slot s at entries 2 * s and 2 * s + 1. Free slots hold
+  // site -1
+  vec1i slots_m {};
+  std::size_t n_slots_m {0};
+  std::size_t n_entries_m {0};
+  // 64 - log2(n_slots)
+  unsigned int shift_m {64};
+};
+}  // namespace site_hash_space
+
+#endif
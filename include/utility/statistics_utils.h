@@ -0,0 +1,33 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef STATISTICS_UTILS_HEADER_H
+#define STATISTICS_UTILS_HEADER_H
+
+#include "vector_utils.h"
+
+namespace statistics_space {
+/*
+ * Routines to analyse time series recorded during the MC simulations
+ */
+
+// Marginal standard error rule (MSER): returns the number of initial points
+// of the series to discard so that the standard error of the mean of the
+// remaining points is minimal. Points are grouped in batches of batch_size
+// before the analysis (MSER-5 uses batch_size = 5). The truncation is in
+// units of points of the original series.
+std::size_t mser_truncation(const vec1d& series, std::size_t batch_size = 5);
+
+// A series is considered equilibrated when the MSER truncation point lies in
+// its first half
+bool is_equilibrated(const vec1d& series, std::size_t batch_size = 5);
+
+// Standard error of the mean of a correlated series, estimated with n_batches
+// batch means. Points in series before "first" are ignored. Returns a
+// negative value if there are not enough points to form the batches.
+double batch_means_error(const vec1d& series,
+                         std::size_t n_batches = 20,
+                         std::size_t first = 0);
+}  // namespace statistics_space
+
+#endif
@@ -0,0 +1,67 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#ifndef THREAD_POOL_HEADER_H
+#define THREAD_POOL_HEADER_H
+
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace thread_space {
+/*
+ * Minimal pool of worker threads used by the engines that evolve several
+ * independent copies of the model (replicas) at the same time.
+ * Threads are created once and reused for every call to parallel_for, so that
+ * the cost of spawning threads is not paid at every temperature step.
+ */
+class ThreadPool {
+public:
+  // n_threads <= 0 selects the number of hardware threads
+  ThreadPool(int n_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  int get_n_threads() const { return static_cast<int>(workers_m.size()); };
+
+  /**
+   * Calls task(i) for every i in [0, n_tasks) on the worker threads and
+   * returns once all of them are done. Tasks are handed out one index at a
+   * time, so replicas with uneven costs are balanced between the threads.
+   * If a task throws, the first exception is rethrown in the calling thread.
+   **/
+  void parallel_for(int n_tasks, const std::function<void(int)>& task);
+
+private:
+  // Worker threads
+  std::vector<std::thread> workers_m {};
+  // Guards every variable below
+  std::mutex mutex_m {};
+  // Signals the workers that a new batch of tasks is available
+  std::condition_variable batch_cv_m {};
+  // Signals the calling thread that the current batch is complete
+  std::condition_variable done_cv_m {};
+  // Task of the current batch
+  const std::function<void(int)>* task_m {nullptr};
+  // Number of tasks in the current batch, next task to hand out and number
+  // of tasks completed so far
+  int n_tasks_m {0};
+  int next_task_m {0};
+  int n_done_m {0};
+  // Incremented for every new batch, so that workers do not run a batch twice
+  long batch_id_m {0};
+  // First exception raised by a task of the current batch
+  std::exception_ptr error_m {};
+  // Set when the pool is destroyed
+  bool stop_m {false};
+
+  void worker_loop();
+};
+}  // namespace thread_space
+
+#endif
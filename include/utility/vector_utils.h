@@ -22,6 +22,17 @@ template<std::size_t M, std::size_t N>
 using arr2i = std::array<arr1i<N>, M>;
 
 namespace array_space {
+// Hint the processor to bring the cache line holding address into the cache,
+// where the compiler supports it
+inline void prefetch_address(const void* address)
+{
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(address);
+#else
+  (void)address;
+#endif
+}
+
 /*
  * Routines to assist with manipulation of flattened arrays.
  * Flattened arrays are preferred over nested vector because during the
@@ -50,6 +50,7 @@ class ModelParams(TypedDict, total=False):
     couplings: list[float]
 
     initialize_option:str
+    state_input: str
     state_av_option:bool
     e_av_option: bool
     e_record_option: bool
@@ -180,3 +181,84 @@ def run_simulation(
         else:
             print("overwrite flag set to True: running anyway.")
     subprocess.run([str(exec_path), "-m", str(model_file), "-M", str(mc_file)])
+
+
+# ----- WARM-STARTED PARAMETER SWEEPS -----
+
+
+def order_warm_start_jobs(
+    points: list[float] | list[list[float]] | NDArray[np.float64],
+) -> list[tuple[int, int | None]]:
+    """
+    Order the points of a parameter sweep (e.g. the n_particles of each job) so that every
+    job can warm-start from a finished neighbour. The first point starts from scratch, then
+    the next job is always the remaining point closest to an already scheduled one, which it
+    warm-starts from.
+    Returns (point index, parent index) pairs in execution order, with parent None for the
+    first job. A job only depends on its parent, so jobs with finished parents can run in
+    parallel.
+    """
+    coordinates = np.asarray(points, dtype=float).reshape(len(points), -1)
+    n_points = len(coordinates)
+    if n_points == 0:
+        return []
+    order: list[tuple[int, int | None]] = [(0, None)]
+    # Distance of each point to the closest scheduled one, and that one
+    distances = np.linalg.norm(coordinates - coordinates[0], axis=1)
+    parents = np.zeros(n_points, dtype=int)
+    scheduled = np.zeros(n_points, dtype=bool)
+    scheduled[0] = True
+    for _ in range(n_points - 1):
+        next_point = int(np.argmin(np.where(scheduled, np.inf, distances)))
+        order.append((next_point, int(parents[next_point])))
+        scheduled[next_point] = True
+        new_distances = np.linalg.norm(coordinates - coordinates[next_point], axis=1)
+        closer = new_distances < distances
+        distances[closer] = new_distances[closer]
+        parents[closer] = next_point
+    return order
+
+
+def run_warm_start_sweep(
+    model_params_list: list[ModelParams],
+    mc_params: McParams,
+    sweep_path: str | Path,
+    warm_start_Ti: float,
+    points: list[float] | list[list[float]] | None = None,
+):
+    """
+    Run one job per entry of model_params_list, in the order given by order_warm_start_jobs
+    on points (by default the total number of particles of each job). Job i writes its
+    parameter files and results to sweep_path/job_i/. The first job anneals from the Ti of
+    mc_params; every other one starts from the final structure of its parent with
+    initialize_option "warm_start", which adds or removes particles at random to reach its
+    own n_particles, and anneals from warm_start_Ti. Each job uses its own couplings.
+    """
+    sweep_path = Path(sweep_path)
+    if points is None:
+        points = [float(sum(params["n_particles"])) for params in model_params_list]
+
+    for index, parent in order_warm_start_jobs(points):
+        job_path = sweep_path / f"job_{index}"
+        job_path.mkdir(parents=True, exist_ok=True)
+
+        model_params = cast(ModelParams, dict(model_params_list[index]))
+        job_mc_params = cast(McParams, dict(mc_params))
+        job_mc_params["final_structure_address"] = str(job_path) + "/"
+        job_mc_params["checkpoint_address"] = str(job_path) + "/"
+        model_params["e_av_output"] = str(job_path) + "/"
+        model_params["e_record_output"] = str(job_path) + "/"
+        if parent is not None:
+            model_params["initialize_option"] = "warm_start"
+            model_params["state_input"] = str(
+                sweep_path / f"job_{parent}" / "final_structure.dat"
+            )
+            job_mc_params["Ti"] = warm_start_Ti
+
+        model_file = job_path / "model_params.json"
+        mc_file = job_path / "mc_params.json"
+        with open(model_file, "w") as f:
+            json.dump(model_params, f)
+        with open(mc_file, "w") as f:
+            json.dump(job_mc_params, f)
+        subprocess.run([str(exec_path), "-m", str(model_file), "-M", str(mc_file)])
@@ -0,0 +1,194 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "chemical_potential_scan.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace simulation_space{
+
+  mu_scan_parameters_struct::mu_scan_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (json_mc_params.contains("mu_scan_shifts")) {
+      shifts = json_mc_params["mu_scan_shifts"].template get<vec1d>();
+    }
+    else if (json_mc_params.contains("mu_scan_n_steps")) {
+      int n_steps {json_mc_params["mu_scan_n_steps"].template get<int>()};
+      double first {json_mc_params["mu_scan_min"].template get<double>()};
+      double last {json_mc_params["mu_scan_max"].template get<double>()};
+      for (int k = 0; k < n_steps; k++) {
+        double x {n_steps > 1 ? static_cast<double>(k) / (n_steps - 1) : 0.0};
+        shifts.push_back(first + x * (last - first));
+      }
+    }
+    if (shifts.empty()) {
+      std::cerr << "Chemical potential scan needs mu_scan_shifts, or "
+                   "mu_scan_n_steps, mu_scan_min and mu_scan_max\n";
+      exit(1);
+    }
+    output = mc_parameters.final_structure_address + "mu_scan_";
+    if (json_mc_params.contains("mu_scan_output")) {
+      output = json_mc_params["mu_scan_output"].template get<std::string>();
+    }
+  }
+
+  chemical_potential_scan::chemical_potential_scan(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {mu_scan_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+  {
+  }
+
+  void chemical_potential_scan::run(model_space::model &simulation_model){
+
+    vec1d base_chemical_potentials {
+        simulation_model.get_model_chemical_potentials()};
+    if (base_chemical_potentials.empty()
+        or !simulation_model.is_grand_canonical()) {
+      std::cerr << "Chemical potential scan needs the chemical_potentials "
+                   "model parameter and insert_remove moves\n";
+      exit(1);
+    }
+
+    std::cout << "Grand-canonical scan over " << parameters.shifts.size()
+              << " chemical potential shifts\n";
+
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+
+      double T {T_array[i]};
+      histograms.assign(parameters.shifts.size(), {});
+      averages.clear();
+
+      for (std::size_t k = 0; k < parameters.shifts.size(); k++) {
+        sample_shift(simulation_model, base_chemical_potentials, k, T);
+        std::cout << "T = " << T << ", mu shift = " << parameters.shifts[k]
+                  << ": <N> = " << averages.back()[1] << '\n';
+
+        if (mc_parameters.checkpoint_option) {
+          std::string save_loc {mc_parameters.checkpoint_address
+                                + "structure_" + std::to_string(i)
+                                + "_mu_" + std::to_string(k) + ".dat"};
+          simulation_model.save_model_state(save_loc);
+        }
+      }
+
+      save_results(T);
+    }
+
+    simulation_model.set_model_chemical_potentials(base_chemical_potentials);
+    std::string save_loc {mc_parameters.final_structure_address
+                          + "final_structure.dat"};
+    simulation_model.save_model_state(save_loc);
+  }
+
+  void chemical_potential_scan::sample_shift(
+      model_space::model &simulation_model,
+      const vec1d& base_chemical_potentials,
+      std::size_t k,
+      double T){
+
+    vec1d chemical_potentials {base_chemical_potentials};
+    for (double& mu : chemical_potentials) {
+      mu += parameters.shifts[k];
+    }
+    simulation_model.set_model_chemical_potentials(chemical_potentials);
+
+    for (int step = 0; step < mc_parameters.mcs_eq; step++) {
+      simulation_model.update_model_system(T);
+    }
+
+    std::vector<long>& histogram {histograms[k]};
+    // Grown with the numbers of particles met rather than covering every
+    // site of a possibly huge sparse lattice
+    histogram.clear();
+    vec1d type_sums(chemical_potentials.size(), 0.0);
+    double n_sum {0.0};
+    double n2_sum {0.0};
+    double e_sum {0.0};
+    for (int step = 0; step < mc_parameters.mcs_av; step++) {
+      simulation_model.update_model_system(T);
+      int n {simulation_model.get_model_n_particles()};
+      if (static_cast<std::size_t>(n) >= histogram.size()) {
+        histogram.resize(static_cast<std::size_t>(n) + 1, 0);
+      }
+      histogram[static_cast<std::size_t>(n)]++;
+      n_sum += n;
+      n2_sum += static_cast<double>(n) * n;
+      e_sum += simulation_model.get_model_energy();
+      vec1i particle_numbers {simulation_model.get_model_particle_numbers()};
+      for (std::size_t t = 0; t < type_sums.size(); t++) {
+        type_sums[t] += particle_numbers[t];
+      }
+    }
+
+    double n_samples {static_cast<double>(std::max(mc_parameters.mcs_av, 1))};
+    double n_av {n_sum / n_samples};
+    vec1d line {parameters.shifts[k], n_av, n2_sum / n_samples - n_av * n_av,
+                e_sum / n_samples};
+    for (double type_sum : type_sums) {
+      line.push_back(type_sum / n_samples);
+    }
+    averages.push_back(line);
+  }
+
+  void chemical_potential_scan::save_results(double T){
+    std::string prefix {parameters.output + "T_" + std::to_string(T)};
+
+    // All the histograms cover N from 0 to the largest value met
+    std::size_t n_bins {0};
+    for (const std::vector<long>& histogram : histograms) {
+      n_bins = std::max(n_bins, histogram.size());
+    }
+    for (std::size_t k = 0; k < histograms.size(); k++) {
+      histograms[k].resize(n_bins, 0);
+      std::string histogram_output {prefix + "_mu_" + std::to_string(k)
+                                    + ".dat"};
+      std::ofstream histogram_f;
+      histogram_f.open(histogram_output);
+      if (!histogram_f) {
+        std::cerr << "Could not open " << histogram_output << '\n';
+        exit(1);
+      }
+      histogram_f << "# mu_shift " << parameters.shifts[k] << "\n# N count\n";
+      for (std::size_t n = 0; n < histograms[k].size(); n++) {
+        histogram_f << n << ' ' << histograms[k][n] << '\n';
+      }
+    }
+
+    std::string averages_output {prefix + "_averages.dat"};
+    std::ofstream averages_f;
+    averages_f.open(averages_output);
+    if (!averages_f) {
+      std::cerr << "Could not open " << averages_output << '\n';
+      exit(1);
+    }
+    averages_f << "# mu_shift <N> <N^2>-<N>^2 <E>";
+    for (std::size_t t = 0; t + 4 < averages.front().size(); t++) {
+      averages_f << " <N_" << t << '>';
+    }
+    averages_f << '\n';
+    for (const vec1d& line : averages) {
+      for (double value : line) {
+        averages_f << value << ' ';
+      }
+      averages_f << '\n';
+    }
+  }
+}
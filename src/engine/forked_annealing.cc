@@ -0,0 +1,162 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "forked_annealing.h"
+
+#include "io_utils.h"
+
+#include <fstream>
+
+namespace simulation_space{
+
+  fork_parameters_struct::fork_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (!json_mc_params.contains("fork_T")) {
+      std::cerr << "Forked annealing needs fork_T\n";
+      exit(1);
+    }
+    fork_T = json_mc_params["fork_T"].template get<double>();
+    if (json_mc_params.contains("n_forks")) {
+      n_forks = json_mc_params["n_forks"].template get<int>();
+    }
+    fork_output = mc_parameters.final_structure_address
+                  + "forked_annealing.dat";
+    if (json_mc_params.contains("fork_output")) {
+      fork_output = json_mc_params["fork_output"].template get<std::string>();
+    }
+  }
+
+  forked_annealing::forked_annealing(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {fork_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+      , pool {mc_params.n_threads}
+  {
+    std::random_device dev;
+    rng.seed(dev());
+    if (parameters.n_forks <= 0) {
+      parameters.n_forks = pool.get_n_threads();
+    }
+  }
+
+  void forked_annealing::run(model_space::model &simulation_model){
+
+    // Shared prefix, down to the first temperature at or below fork_T
+    std::size_t fork_step {0};
+    while (fork_step < T_array.size()
+           and T_array[fork_step] > parameters.fork_T) {
+      double T {T_array[fork_step]};
+      vec1d moments {simulate(simulation_model, T)};
+      fork_records.push_back({T, -1.0, moments[0], moments[1]});
+
+      if (mc_parameters.checkpoint_option) {
+        std::string save_loc {mc_parameters.checkpoint_address + "structure_"
+                              + std::to_string(fork_step) + ".dat"};
+        simulation_model.save_model_state(save_loc);
+      }
+      std::cout << "Energy at T = " << T << ": ";
+      simulation_model.print_model_energy();
+      std::cout << '\n';
+      fork_step++;
+    }
+    save_fork_records();
+
+    std::size_t n_forks {static_cast<std::size_t>(parameters.n_forks)};
+    replicas.clear();
+    for (std::size_t k = 0; k < n_forks; k++) {
+      replicas.push_back(simulation_model);
+      replicas.back().reseed_model_rng(static_cast<unsigned int>(rng()));
+    }
+    std::cout << "Forked " << n_forks << " replicas after " << fork_step
+              << " temperature steps, on " << pool.get_n_threads()
+              << " threads\n";
+
+    // Every replica goes through the rest of the schedule on its own
+    std::size_t n_remaining {T_array.size() - fork_step};
+    std::vector<vec2d> replica_moments(n_forks, vec2d(n_remaining));
+    pool.parallel_for(static_cast<int>(n_forks), [&](int r){
+      std::size_t u_r {static_cast<std::size_t>(r)};
+      for (std::size_t i = fork_step; i < T_array.size(); i++) {
+        replica_moments[u_r][i - fork_step] = simulate(replicas[u_r],
+                                                       T_array[i]);
+        if (mc_parameters.checkpoint_option) {
+          std::string save_loc {mc_parameters.checkpoint_address
+                                + "structure_" + std::to_string(i)
+                                + "_fork_" + std::to_string(r) + ".dat"};
+          replicas[u_r].save_model_state(save_loc);
+        }
+      }
+    });
+
+    for (std::size_t i = 0; i < n_remaining; i++) {
+      for (std::size_t k = 0; k < n_forks; k++) {
+        fork_records.push_back({T_array[fork_step + i], static_cast<double>(k),
+                                replica_moments[k][i][0],
+                                replica_moments[k][i][1]});
+      }
+    }
+    save_fork_records();
+
+    std::cout << "Final energies of the replicas:";
+    std::size_t best {0};
+    for (std::size_t k = 0; k < n_forks; k++) {
+      std::cout << ' ' << replicas[k].get_model_energy();
+      if (replicas[k].get_model_energy() < replicas[best].get_model_energy()) {
+        best = k;
+      }
+      std::string save_loc {mc_parameters.final_structure_address
+                            + "final_structure_fork_" + std::to_string(k)
+                            + ".dat"};
+      replicas[k].save_model_state(save_loc);
+    }
+    std::cout << '\n';
+
+    // The lowest-energy replica is also the final structure of the run
+    simulation_model.copy_model_state(replicas[best]);
+    std::string save_loc {mc_parameters.final_structure_address
+                          + "final_structure.dat"};
+    simulation_model.save_model_state(save_loc);
+  }
+
+  vec1d forked_annealing::simulate(model_space::model& system, double T){
+    for (int step = 0; step < mc_parameters.mcs_eq; step++) {
+      system.update_model_system(T);
+    }
+    double e_av {0.0};
+    double e2_av {0.0};
+    for (int step = 0; step < mc_parameters.mcs_av; step++) {
+      system.update_model_system(T);
+      double e {system.get_model_energy()};
+      e_av += e;
+      e2_av += e * e;
+    }
+    if (mc_parameters.mcs_av > 0) {
+      e_av /= mc_parameters.mcs_av;
+      e2_av /= mc_parameters.mcs_av;
+    }
+    return {e_av, e2_av};
+  }
+
+  void forked_annealing::save_fork_records(){
+    io_space::save_vector(fork_records,
+                          static_cast<int>(fork_records.size()),
+                          4,
+                          parameters.fork_output);
+  }
+}
@@ -0,0 +1,319 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "forward_flux_sampling.h"
+
+#include <fstream>
+
+namespace simulation_space{
+
+  ffs_parameters_struct::ffs_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (json_mc_params.contains("ffs_interfaces")) {
+      interfaces = json_mc_params["ffs_interfaces"].template get<vec1i>();
+    }
+    if (interfaces.size() < 2) {
+      std::cerr << "Forward flux sampling needs at least two ffs_interfaces\n";
+      exit(1);
+    }
+    for (std::size_t i = 1; i < interfaces.size(); i++) {
+      if (interfaces[i] <= interfaces[i - 1]) {
+        std::cerr << "ffs_interfaces must be increasing\n";
+        exit(1);
+      }
+    }
+    basin = interfaces[0] - 1;
+    if (json_mc_params.contains("ffs_basin")) {
+      basin = json_mc_params["ffs_basin"].template get<int>();
+    }
+    if (basin >= interfaces[0]) {
+      std::cerr << "ffs_basin must be below the first interface\n";
+      exit(1);
+    }
+    if (json_mc_params.contains("ffs_n_crossings")) {
+      n_crossings = json_mc_params["ffs_n_crossings"].template get<int>();
+    }
+    if (json_mc_params.contains("ffs_n_trials")) {
+      n_trials = json_mc_params["ffs_n_trials"].template get<int>();
+    }
+    if (n_crossings < 1 || n_trials < 1) {
+      std::cerr << "ffs_n_crossings and ffs_n_trials must be positive\n";
+      exit(1);
+    }
+    if (json_mc_params.contains("ffs_max_sweeps")) {
+      max_sweeps = json_mc_params["ffs_max_sweeps"].template get<long>();
+    }
+    output = mc_parameters.final_structure_address + "ffs_";
+    if (json_mc_params.contains("ffs_output")) {
+      output = json_mc_params["ffs_output"].template get<std::string>();
+    }
+  }
+
+  forward_flux_sampling::forward_flux_sampling(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {ffs_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+      , pool {mc_params.n_threads}
+  {
+    std::random_device dev;
+    rng.seed(dev());
+  }
+
+  void forward_flux_sampling::run(model_space::model &simulation_model){
+
+    int n_walkers {pool.get_n_threads()};
+    std::size_t n_interfaces {parameters.interfaces.size()};
+
+    std::random_device dev;
+    walkers.clear();
+    for (int w = 0; w < n_walkers; w++) {
+      walkers.push_back(simulation_model);
+      walkers.back().reseed_model_rng(dev());
+    }
+    particles_space::SiteVector initial_sites {
+        simulation_model.get_model_configuration()};
+
+    std::cout << "Forward flux sampling through " << n_interfaces
+              << " interfaces of the largest cluster size with "
+              << n_walkers << " walkers\n";
+
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+
+      double T {T_array[i]};
+      configurations.assign(n_interfaces, {});
+      n_fired.assign(n_interfaces - 1, 0);
+      n_successes.assign(n_interfaces - 1, 0);
+
+      double flux {run_flux_stage(initial_sites, T)};
+      double rate {flux};
+      std::cout << "T = " << T << ": flux through lambda_0 " << flux;
+
+      for (std::size_t k = 0; k + 1 < n_interfaces; k++) {
+        if (configurations[k].empty()) {
+          rate = 0.0;
+          break;
+        }
+        run_trials(k, T);
+        rate *= static_cast<double>(n_successes[k])
+                / static_cast<double>(n_fired[k]);
+        std::cout << ", P(" << k + 1 << '|' << k << ") "
+                  << static_cast<double>(n_successes[k])
+                     / static_cast<double>(n_fired[k]);
+      }
+      std::cout << "\nNucleation rate " << rate << " per lattice update\n";
+
+      rate_records.push_back({T, flux, rate});
+      save_interfaces(T);
+      save_paths(T);
+    }
+
+    std::string rates_output {parameters.output + "rates.dat"};
+    io_space::save_vector(rate_records,
+                          static_cast<int>(rate_records.size()), 3,
+                          rates_output);
+  }
+
+  double forward_flux_sampling::run_flux_stage(
+      const particles_space::SiteVector& initial_sites, double T){
+    /*
+     * Every walker collects its share of the crossings. A walker reaching the
+     * last interface has left the basin for good, and restarts from the
+     * initial configuration
+     */
+
+    int n_walkers {static_cast<int>(walkers.size())};
+    int first {parameters.interfaces.front()};
+    int last {parameters.interfaces.back()};
+    std::vector<std::vector<particles_space::SiteVector>> crossings(
+        walkers.size());
+    std::vector<long> sweeps(walkers.size(), 0);
+
+    pool.parallel_for(n_walkers, [&](int w){
+      std::size_t u_w {static_cast<std::size_t>(w)};
+      model_space::model& walker {walkers[u_w]};
+      int target {parameters.n_crossings / n_walkers
+                  + (w < parameters.n_crossings % n_walkers ? 1 : 0)};
+
+      walker.set_model_configuration(initial_sites);
+      for (int step = 0; step < mc_parameters.mcs_eq; step++) {
+        walker.update_model_system(T);
+      }
+      bool from_basin {walker.get_model_largest_cluster() <= parameters.basin};
+
+      while (static_cast<int>(crossings[u_w].size()) < target
+             && sweeps[u_w] < parameters.max_sweeps) {
+        walker.update_model_system(T);
+        sweeps[u_w]++;
+        int n {walker.get_model_largest_cluster()};
+        if (n <= parameters.basin) {
+          from_basin = true;
+        }
+        else if (n >= first && from_basin) {
+          crossings[u_w].push_back(walker.get_model_configuration());
+          from_basin = false;
+        }
+        if (n >= last) {
+          walker.set_model_configuration(initial_sites);
+          from_basin =
+              walker.get_model_largest_cluster() <= parameters.basin;
+        }
+      }
+    });
+
+    long total_sweeps {0};
+    for (std::size_t w = 0; w < walkers.size(); w++) {
+      total_sweeps += sweeps[w];
+      for (particles_space::SiteVector& sites : crossings[w]) {
+        configurations[0].push_back({sites, -1});
+      }
+    }
+    if (static_cast<int>(configurations[0].size()) < parameters.n_crossings) {
+      std::cerr << "Warning: only " << configurations[0].size()
+                << " crossings of lambda_0 in ffs_max_sweeps at T = " << T
+                << '\n';
+    }
+
+    return total_sweeps > 0 ? static_cast<double>(configurations[0].size())
+                                  / static_cast<double>(total_sweeps)
+                            : 0.0;
+  }
+
+  void forward_flux_sampling::run_trials(std::size_t i, double T){
+    /*
+     * The starting configuration and seed of every trial are drawn before
+     * the trials are distributed among the walkers, and the successes are
+     * stored in the order of the trials
+     */
+
+    int n_walkers {static_cast<int>(walkers.size())};
+    std::size_t n_trials {static_cast<std::size_t>(parameters.n_trials)};
+    int target {parameters.interfaces[i + 1]};
+
+    std::uniform_int_distribution<std::size_t> pick_start(
+        0, configurations[i].size() - 1);
+    std::vector<std::size_t> starts(n_trials);
+    std::vector<unsigned int> seeds(n_trials);
+    for (std::size_t t = 0; t < n_trials; t++) {
+      starts[t] = pick_start(rng);
+      seeds[t] = static_cast<unsigned int>(rng());
+    }
+    std::vector<ffs_configuration_struct> results(n_trials);
+    std::vector<char> successes(n_trials, 0);
+
+    pool.parallel_for(n_walkers, [&](int w){
+      model_space::model& walker {walkers[static_cast<std::size_t>(w)]};
+      for (std::size_t t = static_cast<std::size_t>(w); t < n_trials;
+           t += static_cast<std::size_t>(n_walkers)) {
+        walker.set_model_configuration(configurations[i][starts[t]].sites);
+        walker.reseed_model_rng(seeds[t]);
+        for (long sweep = 0; sweep < parameters.max_sweeps; sweep++) {
+          walker.update_model_system(T);
+          int n {walker.get_model_largest_cluster()};
+          if (n >= target) {
+            results[t] = {walker.get_model_configuration(),
+                          static_cast<int>(starts[t])};
+            successes[t] = 1;
+            break;
+          }
+          if (n <= parameters.basin) {
+            break;
+          }
+        }
+      }
+    });
+
+    n_fired[i] = parameters.n_trials;
+    for (std::size_t t = 0; t < n_trials; t++) {
+      if (successes[t]) {
+        configurations[i + 1].push_back(results[t]);
+        n_successes[i]++;
+      }
+    }
+  }
+
+  void forward_flux_sampling::save_interfaces(double T){
+    std::string interfaces_output {parameters.output + "T_" + std::to_string(T)
+                                   + "_interfaces.dat"};
+    std::ofstream interfaces_f;
+    interfaces_f.open(interfaces_output);
+    if (!interfaces_f) {
+      std::cerr << "Could not open " << interfaces_output << '\n';
+      exit(1);
+    }
+    interfaces_f << "# lambda n_configurations n_trials n_successes P\n";
+    for (std::size_t k = 0; k < configurations.size(); k++) {
+      interfaces_f << parameters.interfaces[k] << ' '
+                   << configurations[k].size();
+      if (k < n_fired.size()) {
+        interfaces_f << ' ' << n_fired[k] << ' ' << n_successes[k] << ' '
+                     << (n_fired[k] > 0
+                             ? static_cast<double>(n_successes[k])
+                                   / static_cast<double>(n_fired[k])
+                             : 0.0);
+      }
+      interfaces_f << '\n';
+    }
+  }
+
+  void forward_flux_sampling::save_paths(double T){
+    /*
+     * Every configuration reaching the last interface is traced back to
+     * lambda_0. The paths file holds one line per path with the index of its
+     * configuration at each interface, and the configurations along the
+     * paths are saved as <prefix>T_<T>_interface_<k>_<index>.dat
+     */
+
+    std::string prefix {parameters.output + "T_" + std::to_string(T)};
+    std::size_t n_interfaces {configurations.size()};
+
+    std::vector<std::vector<bool>> on_path(n_interfaces);
+    for (std::size_t k = 0; k < n_interfaces; k++) {
+      on_path[k].assign(configurations[k].size(), false);
+    }
+
+    vec2i paths {};
+    for (std::size_t j = 0; j < configurations.back().size(); j++) {
+      vec1i path(n_interfaces);
+      int index {static_cast<int>(j)};
+      for (std::size_t k = n_interfaces; k-- > 0;) {
+        std::size_t u_index {static_cast<std::size_t>(index)};
+        path[k] = index;
+        on_path[k][u_index] = true;
+        index = configurations[k][u_index].parent;
+      }
+      paths.push_back(path);
+    }
+    std::string paths_output {prefix + "_paths.dat"};
+    io_space::save_vector(paths, static_cast<int>(paths.size()),
+                          static_cast<int>(n_interfaces), paths_output);
+
+    model_space::model& writer {walkers.front()};
+    for (std::size_t k = 0; k < n_interfaces; k++) {
+      for (std::size_t j = 0; j < configurations[k].size(); j++) {
+        if (!on_path[k][j]) {
+          continue;
+        }
+        std::string save_loc {prefix + "_interface_" + std::to_string(k)
+                              + "_" + std::to_string(j) + ".dat"};
+        writer.set_model_configuration(configurations[k][j].sites);
+        writer.save_model_state(save_loc);
+      }
+    }
+  }
+}
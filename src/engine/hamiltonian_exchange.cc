@@ -0,0 +1,245 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "hamiltonian_exchange.h"
+#include "io_utils.h"
+
+#include <algorithm>
+
+namespace simulation_space{
+
+  exchange_parameters_struct::exchange_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (json_mc_params.contains("n_replicas")) {
+      n_replicas = json_mc_params["n_replicas"].template get<int>();
+    }
+    if (json_mc_params.contains("exchange_interval")) {
+      exchange_interval =
+          json_mc_params["exchange_interval"].template get<int>();
+      if (exchange_interval < 1) {
+        std::cerr << "exchange_interval must be positive\n";
+        exit(1);
+      }
+    }
+    exchange_output = mc_parameters.final_structure_address
+                      + "hamiltonian_exchange.dat";
+    if (json_mc_params.contains("exchange_output")) {
+      exchange_output =
+          json_mc_params["exchange_output"].template get<std::string>();
+    }
+  }
+
+  hamiltonian_exchange::hamiltonian_exchange(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {exchange_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+      , pool {mc_params.n_threads}
+  {
+    std::random_device dev;
+    rng.seed(dev());
+  }
+
+  void hamiltonian_exchange::set_couplings(
+      model_space::model &simulation_model){
+    couplings = simulation_model.get_model_replica_couplings();
+    if (couplings.size() < 2) {
+      std::cerr << "Hamiltonian exchange needs at least two replica_couplings "
+                   "in the model parameters\n";
+      exit(1);
+    }
+
+    // Linear interpolation between two end points
+    if (couplings.size() == 2 and parameters.n_replicas > 2) {
+      vec1d first {couplings[0]};
+      vec1d last {couplings[1]};
+      std::size_t n_replicas {static_cast<std::size_t>(parameters.n_replicas)};
+      couplings.clear();
+      for (std::size_t k = 0; k < n_replicas; k++) {
+        double x {static_cast<double>(k) / static_cast<double>(n_replicas - 1)};
+        vec1d interpolated(first.size());
+        for (std::size_t c = 0; c < first.size(); c++) {
+          interpolated[c] = (1.0 - x) * first[c] + x * last[c];
+        }
+        couplings.push_back(interpolated);
+      }
+    }
+    else if (parameters.n_replicas > 0
+             and static_cast<std::size_t>(parameters.n_replicas)
+                 != couplings.size()) {
+      std::cerr << "n_replicas does not match the number of "
+                   "replica_couplings\n";
+      exit(1);
+    }
+  }
+
+  void hamiltonian_exchange::run(model_space::model &simulation_model){
+
+    set_couplings(simulation_model);
+    std::size_t n_hamiltonians {couplings.size()};
+
+    // Replica k starts from the input configuration with Hamiltonian k and its
+    // own seed
+    replicas.clear();
+    holders.clear();
+    for (std::size_t k = 0; k < n_hamiltonians; k++) {
+      replicas.push_back(simulation_model);
+      replicas.back().reseed_model_rng(static_cast<unsigned int>(rng()));
+      replicas.back().set_model_couplings(couplings[k]);
+      holders.push_back(k);
+    }
+
+    std::cout << "Hamiltonian exchange between " << n_hamiltonians
+              << " replicas on " << pool.get_n_threads() << " threads\n";
+
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+
+      double T {T_array[i]};
+      n_attempts.assign(n_hamiltonians - 1, 0);
+      n_accepted.assign(n_hamiltonians - 1, 0);
+
+      vec1d e_av {};
+      vec1d e2_av {};
+      sweep_replicas(T, mc_parameters.mcs_eq, e_av, e2_av);
+      e_av.assign(n_hamiltonians, 0.0);
+      e2_av.assign(n_hamiltonians, 0.0);
+      sweep_replicas(T, mc_parameters.mcs_av, e_av, e2_av);
+
+      for (std::size_t k = 0; k < n_hamiltonians; k++) {
+        if (mc_parameters.mcs_av > 0) {
+          e_av[k] /= mc_parameters.mcs_av;
+          e2_av[k] /= mc_parameters.mcs_av;
+        }
+        double acceptance {0.0};
+        if (k + 1 < n_hamiltonians and n_attempts[k] > 0) {
+          acceptance = static_cast<double>(n_accepted[k])
+                       / static_cast<double>(n_attempts[k]);
+        }
+        exchange_records.push_back(
+            {T, static_cast<double>(k), e_av[k], e2_av[k], acceptance});
+
+        if (mc_parameters.checkpoint_option) {
+          std::string save_loc {mc_parameters.checkpoint_address
+                                + "structure_" + std::to_string(i)
+                                + "_hamiltonian_" + std::to_string(k)
+                                + ".dat"};
+          replicas[holders[k]].save_model_state(save_loc);
+        }
+      }
+      save_exchange_records();
+
+      std::cout << "Energies at T = " << T << ":";
+      for (std::size_t k = 0; k < n_hamiltonians; k++) {
+        std::cout << ' ' << replicas[holders[k]].get_model_energy();
+      }
+      std::cout << '\n';
+    }
+
+    for (std::size_t k = 0; k < n_hamiltonians; k++) {
+      std::string save_loc {mc_parameters.final_structure_address
+                            + "final_structure_hamiltonian_"
+                            + std::to_string(k) + ".dat"};
+      replicas[holders[k]].save_model_state(save_loc);
+    }
+  }
+
+  void hamiltonian_exchange::sweep_replicas(double T, int n_sweeps,
+                                            vec1d& e_av, vec1d& e2_av){
+    bool sampling {!e_av.empty()};
+    // Energy sums of each replica over the current block
+    vec1d block_e(replicas.size());
+    vec1d block_e2(replicas.size());
+    int done {0};
+    std::size_t parity {0};
+    while (done < n_sweeps) {
+      int n_block {std::min(parameters.exchange_interval, n_sweeps - done)};
+      pool.parallel_for(static_cast<int>(replicas.size()), [&](int r){
+        std::size_t u_r {static_cast<std::size_t>(r)};
+        block_e[u_r] = 0.0;
+        block_e2[u_r] = 0.0;
+        for (int step = 0; step < n_block; step++) {
+          replicas[u_r].update_model_system(T);
+          if (sampling) {
+            double e {replicas[u_r].get_model_energy()};
+            block_e[u_r] += e;
+            block_e2[u_r] += e * e;
+          }
+        }
+      });
+      done += n_block;
+
+      // Energies are sampled after every update. A replica keeps its
+      // Hamiltonian during a block, so its sums go to the Hamiltonian it
+      // holds before the exchanges
+      if (sampling) {
+        for (std::size_t k = 0; k < holders.size(); k++) {
+          e_av[k] += block_e[holders[k]];
+          e2_av[k] += block_e2[holders[k]];
+        }
+      }
+
+      attempt_exchanges(T, parity);
+      parity = 1 - parity;
+    }
+  }
+
+  void hamiltonian_exchange::attempt_exchanges(double T, std::size_t parity){
+    std::size_t n_pairs {0};
+    for (std::size_t k = parity; k + 1 < holders.size(); k += 2) {
+      n_pairs++;
+    }
+
+    // Energies of the configurations under the Hamiltonian of their partner,
+    // computed in parallel
+    vec1d cross_e_lower(n_pairs);
+    vec1d cross_e_upper(n_pairs);
+    pool.parallel_for(static_cast<int>(n_pairs), [&](int p){
+      std::size_t u_p {static_cast<std::size_t>(p)};
+      std::size_t k {parity + 2 * u_p};
+      // Configuration holding k + 1 under H_k, and the reverse
+      cross_e_lower[u_p] =
+          replicas[holders[k + 1]].get_model_energy(couplings[k]);
+      cross_e_upper[u_p] =
+          replicas[holders[k]].get_model_energy(couplings[k + 1]);
+    });
+
+    std::uniform_real_distribution<double> u_dist(0.0, 1.0);
+    for (std::size_t p = 0; p < n_pairs; p++) {
+      std::size_t k {parity + 2 * p};
+      model_space::model& lower {replicas[holders[k]]};
+      model_space::model& upper {replicas[holders[k + 1]]};
+      double delta {(cross_e_lower[p] + cross_e_upper[p]
+                     - lower.get_model_energy() - upper.get_model_energy())
+                    / T};
+      n_attempts[k]++;
+      if (delta <= 0 or std::exp(-delta) > u_dist(rng)) {
+        n_accepted[k]++;
+        lower.set_model_couplings(couplings[k + 1], cross_e_upper[p]);
+        upper.set_model_couplings(couplings[k], cross_e_lower[p]);
+        std::swap(holders[k], holders[k + 1]);
+      }
+    }
+  }
+
+  void hamiltonian_exchange::save_exchange_records(){
+    io_space::save_vector(exchange_records,
+                          static_cast<int>(exchange_records.size()),
+                          5,
+                          parameters.exchange_output);
+  }
+}
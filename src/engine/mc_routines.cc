@@ -2,10 +2,22 @@
 // Part of frusa_mc, released under BSD 3-Clause License.
 
 #include "mc_routines.h"
+#include "population_annealing.h"
+#include "hamiltonian_exchange.h"
+#include "umbrella_sampling.h"
+#include "forward_flux_sampling.h"
+#include "chemical_potential_scan.h"
+#include "forked_annealing.h"
+#include "simulated_tempering.h"
+#include "io_utils.h"
+#include "statistics_utils.h"
+
+#include <algorithm>
 
 namespace simulation_space{
 
-  mc_parameters_struct::mc_parameters_struct(std::string& mc_input){
+  mc_parameters_struct::mc_parameters_struct(std::string& mc_input,
+                                             bool verbose){
     /*
      * Populate the struct using the input JSON file
      */
@@ -28,7 +40,9 @@ namespace simulation_space{
     Nt                = json_mc_params["Nt"].template get<int>();
     checkpoint_option =
         json_mc_params["checkpoint_option"].template get<bool>();
-  std::cout << "All mc parameters loaded successfully" ;
+    if (verbose) {
+      std::cout << "All mc parameters loaded successfully" ;
+    }
 
     if (checkpoint_option) {
       checkpoint_address =
@@ -36,9 +50,89 @@ namespace simulation_space{
     }
     final_structure_address =
         json_mc_params["final_structure_address"].template get<std::string>();
+
+    // Optional parameters, absent from older input files
+    if (json_mc_params.contains("simulation_mode")) {
+      simulation_mode =
+          json_mc_params["simulation_mode"].template get<std::string>();
+    }
+    if (json_mc_params.contains("n_threads")) {
+      n_threads = json_mc_params["n_threads"].template get<int>();
+    }
+    if (json_mc_params.contains("n_lanes")) {
+      n_lanes = json_mc_params["n_lanes"].template get<int>();
+    }
+    if (json_mc_params.contains("adaptive_step")) {
+      adaptive_step = json_mc_params["adaptive_step"].template get<double>();
+    }
+    sweep_budget = static_cast<long>(Nt) * (mcs_eq + mcs_av);
+    if (json_mc_params.contains("sweep_budget")) {
+      sweep_budget = json_mc_params["sweep_budget"].template get<long>();
+    }
+    if (json_mc_params.contains("auto_equilibration")) {
+      auto_equilibration =
+          json_mc_params["auto_equilibration"].template get<bool>();
+    }
+    if (json_mc_params.contains("check_interval")) {
+      check_interval = json_mc_params["check_interval"].template get<int>();
+    }
+    if (json_mc_params.contains("e_error_target")) {
+      e_error_target = json_mc_params["e_error_target"].template get<double>();
+    }
+    if (json_mc_params.contains("sweeps_per_update")) {
+      sweeps_per_update =
+          json_mc_params["sweeps_per_update"].template get<int>();
+    }
+    n_windows = Nt;
+    if (json_mc_params.contains("n_windows")) {
+      n_windows = json_mc_params["n_windows"].template get<int>();
+    }
+    if (json_mc_params.contains("stop_check_interval")) {
+      stop_check_interval =
+          json_mc_params["stop_check_interval"].template get<int>();
+    }
+    if (json_mc_params.contains("stop_largest_cluster")) {
+      stop_largest_cluster =
+          json_mc_params["stop_largest_cluster"].template get<int>();
+    }
+    if (json_mc_params.contains("stop_energy_per_particle")) {
+      stop_energy_per_particle =
+          json_mc_params["stop_energy_per_particle"].template get<double>();
+    }
+    if (json_mc_params.contains("stop_frozen_sweeps")) {
+      stop_frozen_sweeps =
+          json_mc_params["stop_frozen_sweeps"].template get<int>();
+    }
+    if (json_mc_params.contains("microcanonical_T")) {
+      microcanonical_T =
+          json_mc_params["microcanonical_T"].template get<double>();
+    }
+    if (json_mc_params.contains("demon_energy_step")) {
+      demon_energy_step =
+          json_mc_params["demon_energy_step"].template get<double>();
+    }
+    if (json_mc_params.contains("n_cycles")) {
+      n_cycles = json_mc_params["n_cycles"].template get<int>();
+    }
+    if (json_mc_params.contains("restart_from_best")) {
+      restart_from_best =
+          json_mc_params["restart_from_best"].template get<bool>();
+    }
+    if (json_mc_params.contains("final_quench")) {
+      final_quench = json_mc_params["final_quench"].template get<bool>();
+    }
+  }
+
+  bool mc_parameters_struct::has_stop_rule() const {
+    return stop_largest_cluster > 0
+           or stop_energy_per_particle != -HUGE_VAL
+           or stop_frozen_sweeps > 0;
   }
 
-  mc::mc(std::string& mc_input): parameters {mc_parameters_struct(mc_input)}{
+  mc::mc(std::string& mc_input, bool verbose)
+      : parameters {mc_parameters_struct(mc_input, verbose)}
+      , mc_input_file {mc_input}
+  {
 
     // Map the cooling option on the integer variable
     try{
@@ -51,6 +145,9 @@ namespace simulation_space{
       else if(parameters.cooling_schedule=="inverse"){
         cooling_option = 2;
       }
+      else if(parameters.cooling_schedule=="adaptive"){
+        cooling_option = 3;
+      }
       else{
         throw parameters.cooling_schedule;
       }
@@ -61,6 +158,54 @@ namespace simulation_space{
       exit(1);
     }
 
+    // Map the simulation mode on the integer variable
+    try{
+      if(parameters.simulation_mode=="annealing"){
+        simulation_option = 0;
+      }
+      else if(parameters.simulation_mode=="population_annealing"){
+        simulation_option = 1;
+      }
+      else if(parameters.simulation_mode=="lockstep"){
+        simulation_option = 2;
+      }
+      else if(parameters.simulation_mode=="quench"){
+        simulation_option = 3;
+      }
+      else if(parameters.simulation_mode=="continuous_annealing"){
+        simulation_option = 4;
+      }
+      else if(parameters.simulation_mode=="hamiltonian_exchange"){
+        simulation_option = 5;
+      }
+      else if(parameters.simulation_mode=="transfer_matrix"){
+        simulation_option = 6;
+      }
+      else if(parameters.simulation_mode=="umbrella_sampling"){
+        simulation_option = 7;
+      }
+      else if(parameters.simulation_mode=="forward_flux_sampling"){
+        simulation_option = 8;
+      }
+      else if(parameters.simulation_mode=="chemical_potential_scan"){
+        simulation_option = 9;
+      }
+      else if(parameters.simulation_mode=="forked_annealing"){
+        simulation_option = 10;
+      }
+      else if(parameters.simulation_mode=="simulated_tempering"){
+        simulation_option = 11;
+      }
+      else{
+        throw parameters.simulation_mode;
+      }
+    }
+
+    catch(std::string simulation_mode){
+      std::cout << simulation_mode << ": Incorrect simulation mode!\n";
+      exit(1);
+    }
+
     // Define the array of temperatures for the annealing
     double dT = (parameters.Tf - parameters.Ti) / (parameters.Nt - 1);
 
@@ -77,7 +222,16 @@ namespace simulation_space{
     std::cout << "Number of equilibration steps mcs_eq = ";
     std::cout << parameters.mcs_eq << "\n";
     std::cout << "Number of averaging steps mcs_av = ";
-    std::cout << parameters.mcs_av << "\n\n";
+    std::cout << parameters.mcs_av << "\n";
+    if (parameters.auto_equilibration) {
+      std::cout << "Equilibration stops on the MSER test, checked every ";
+      std::cout << parameters.check_interval << " steps\n";
+    }
+    if (parameters.e_error_target > 0.0) {
+      std::cout << "Averaging stops when the error on <E> is below ";
+      std::cout << parameters.e_error_target << "\n";
+    }
+    std::cout << "\n";
 
     std::cout << "Initial temperature Ti = ";
     std::cout << parameters.Ti << "\n";
@@ -89,6 +243,9 @@ namespace simulation_space{
     std::cout << "The selected cooling schedule is ";
     std::cout << parameters.cooling_schedule << "\n\n";
 
+    std::cout << "The selected simulation mode is ";
+    std::cout << parameters.simulation_mode << "\n\n";
+
     if(parameters.checkpoint_option){
       std::cout << "Output location for checkpoints: ";
       std::cout << parameters.checkpoint_address << "\n\n";
@@ -98,60 +255,664 @@ namespace simulation_space{
     std::cout << parameters.final_structure_address << "\n\n";
   }
 
+  void mc::run(model_space::model &simulation_model){
+    // The adaptive schedule is built during the annealing, and the other
+    // modes need a fixed grid of temperatures
+    if (cooling_option == 3 and simulation_option != 0
+        and simulation_option != 3)
+    {
+      std::cerr << "The adaptive cooling schedule is only available in the "
+                   "annealing mode, not in " << parameters.simulation_mode
+                << '\n';
+      exit(1);
+    }
+    // The other modes never stop before the end of their schedule
+    if (parameters.has_stop_rule() and simulation_option != 0
+        and simulation_option != 4)
+    {
+      std::cerr << "The stopping rules are only available in the annealing "
+                   "and continuous_annealing modes, not in "
+                << parameters.simulation_mode << '\n';
+      exit(1);
+    }
+    switch(simulation_option){
+      case 0:
+        t_scan(simulation_model);
+        break;
+      case 1:
+        {
+          population_annealing population {mc_input_file, parameters,
+                                           get_temperatures()};
+          population.anneal(simulation_model);
+        }
+        break;
+      case 2:
+        lockstep_scan(simulation_model);
+        break;
+      case 3:
+        quench(simulation_model);
+        save_final_state(simulation_model);
+        break;
+      case 4:
+        continuous_scan(simulation_model);
+        break;
+      case 5:
+        {
+          hamiltonian_exchange exchange {mc_input_file, parameters,
+                                         get_temperatures()};
+          exchange.run(simulation_model);
+        }
+        break;
+      case 6:
+        transfer_matrix_scan(simulation_model);
+        break;
+      case 7:
+        {
+          umbrella_sampling umbrella {mc_input_file, parameters,
+                                      get_temperatures()};
+          umbrella.run(simulation_model);
+        }
+        break;
+      case 8:
+        {
+          forward_flux_sampling ffs {mc_input_file, parameters,
+                                     get_temperatures()};
+          ffs.run(simulation_model);
+        }
+        break;
+      case 9:
+        {
+          chemical_potential_scan scan {mc_input_file, parameters,
+                                        get_temperatures()};
+          scan.run(simulation_model);
+        }
+        break;
+      case 10:
+        {
+          forked_annealing forks {mc_input_file, parameters,
+                                  get_temperatures()};
+          forks.run(simulation_model);
+        }
+        break;
+      case 11:
+        {
+          simulated_tempering tempering {mc_input_file, parameters,
+                                         get_temperatures()};
+          tempering.run(simulation_model);
+        }
+        break;
+    }
+    simulation_model.print_model_cache_statistics();
+  }
+
+  double mc::get_temperature(std::size_t i){
+    return apply_cooling_law(T_array[i]);
+  }
+
+  double mc::apply_cooling_law(double x){
+    double T {x};
+
+    switch(cooling_option){
+      case 0:
+        T = pow(10,x);
+        break;
+      case 1:
+        T = x;
+        break;
+      case 2:
+        T = 1.0 / x;
+        break;
+      case 3:
+        // The adaptive schedule is built during the annealing and has no
+        // fixed grid
+        std::cerr << "The adaptive cooling schedule is only available in the "
+                     "annealing mode\n";
+        exit(1);
+    }
+    return T;
+  }
+
+  vec1d mc::get_temperatures(){
+    vec1d temperatures {};
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+      temperatures.push_back(get_temperature(i));
+    }
+    return temperatures;
+  }
+
   void mc::t_scan(model_space::model &simulation_model){
 
-    for (std::size_t i = 0; i < static_cast<std::size_t>(parameters.Nt); i++) {
+    /*
+     * With n_cycles > 1, the schedule, fixed or adaptive, is repeated,
+     * reheating the system to Ti at the start of every cycle. With
+     * restart_from_best, every new cycle starts from the lowest-energy
+     * configuration met so far instead of the last one.
+     */
+    if (parameters.restart_from_best
+        and !simulation_model.is_best_state_tracked())
+    {
+      std::cerr << "restart_from_best needs the best_state_option model "
+                   "parameter\n";
+      exit(1);
+    }
 
-      double T;
+    std::size_t n_steps {static_cast<std::size_t>(parameters.Nt)};
+    // Checkpoints are numbered by temperature step over all the cycles
+    std::size_t checkpoint {0};
+    for (int cycle = 0; cycle < parameters.n_cycles; cycle++) {
 
-      switch(cooling_option){
-        case 0:
-          T = pow(10,T_array[i]);
-          break;
-        case 1:
-          T = T_array[i];
+      if (cycle > 0 and parameters.restart_from_best) {
+        simulation_model.restore_model_best_state();
+        std::cout << "Cycle " << cycle << " restarts from the best energy ";
+        simulation_model.print_model_energy();
+        std::cout << '\n';
+      }
+
+      if (cooling_option == 3) {
+        adaptive_t_scan(simulation_model, checkpoint);
+        if (run_stopped) {
           break;
-        case 2:
-          T = 1.0 / T_array[i];
+        }
+        continue;
+      }
+
+      for (std::size_t i = 0; i < n_steps; i++) {
+
+        double T {get_temperature(i)};
+
+        mc_simulate(simulation_model,T);
+        if (run_stopped) {
           break;
+        }
+
+        if(parameters.checkpoint_option){
+          std::string save_loc {parameters.checkpoint_address + "structure_"
+                                + std::to_string(checkpoint) + ".dat"};
+          simulation_model.save_model_state(save_loc);
+        }
+        checkpoint++;
+        std::cout << "Energy at T = " << T << ": ";
+        simulation_model.print_model_energy();
+        std::cout << '\n' ;
+      }
+      if (run_stopped) {
+        break;
       }
+    }
+    if (parameters.final_quench) {
+      quench(simulation_model);
+    }
+    save_final_state(simulation_model);
+  }
+
+  void mc::adaptive_t_scan(model_space::model &simulation_model,
+                           std::size_t& checkpoint){
+
+    /*
+     * Temperatures are chosen on the fly so that consecutive steps are
+     * separated by delta_beta = adaptive_step / sigma_E, where sigma_E is the
+     * standard deviation of the energy measured at the current temperature.
+     * With adaptive_step ~ 1, the energy histograms of neighbouring
+     * temperatures overlap, which is the same as moving at constant
+     * thermodynamic speed: small steps where the heat capacity
+     * sigma_E^2 / T^2 is large, large ones where nothing happens.
+     * Steps are never smaller than what is needed to reach Tf within
+     * sweep_budget lattice updates.
+     */
+    double beta {1.0 / parameters.Ti};
+    const double beta_f {1.0 / parameters.Tf};
+    const long sweeps_per_step {
+        static_cast<long>(parameters.mcs_eq + parameters.mcs_av)};
+    long used_sweeps {0};
+
+    while (true) {
+
+      double T {1.0 / beta};
 
       mc_simulate(simulation_model,T);
+      used_sweeps += last_sweeps;
+      if (run_stopped) {
+        break;
+      }
 
       if(parameters.checkpoint_option){
         std::string save_loc {parameters.checkpoint_address + "structure_"
-                              + std::to_string(i) + ".dat"};
+                              + std::to_string(checkpoint) + ".dat"};
         simulation_model.save_model_state(save_loc);
       }
+      checkpoint++;
       std::cout << "Energy at T = " << T << ": ";
       simulation_model.print_model_energy();
       std::cout << '\n' ;
+
+      if (beta >= beta_f) {
+        break;
+      }
+
+      double sigma_e {std::sqrt(std::max(
+          e2_av_measured - e_av_measured * e_av_measured, 0.0))};
+      double delta_beta {beta_f - beta};
+      if (sigma_e > 0.0) {
+        delta_beta = std::min(delta_beta, parameters.adaptive_step / sigma_e);
+      }
+
+      // Make sure that the remaining budget is enough to reach Tf
+      long remaining_steps {(parameters.sweep_budget - used_sweeps)
+                            / std::max(sweeps_per_step, 1L)};
+      if (remaining_steps <= 1) {
+        delta_beta = beta_f - beta;
+      }
+      else {
+        delta_beta = std::max(
+            delta_beta, (beta_f - beta) / static_cast<double>(remaining_steps));
+      }
+
+      beta = std::min(beta + delta_beta, beta_f);
     }
-    std::string final_state_save_loc{parameters.final_structure_address +
-                                     "final_structure.dat"};
-    simulation_model.save_model_state(final_state_save_loc);
+    std::cout << "Adaptive annealing used " << used_sweeps
+              << " lattice updates\n";
   }
 
   void mc::mc_simulate(model_space::model &simulation_model, double T){
 
-    // Equilibrate the system for mcs_eq steps
-    for (int step = 0; step < parameters.mcs_eq; step++) {
+    /*
+     * With auto_equilibration, the energy is recorded after every step and
+     * equilibration stops as soon as the MSER truncation point of the series
+     * lies in its first half. With e_error_target > 0, averaging stops as soon
+     * as the batch-means error on <E> is below the target. mcs_eq and mcs_av
+     * are upper bounds in both cases.
+     */
+    const int check_interval {std::max(parameters.check_interval, 1)};
+    // Batch means need a few points per batch to be meaningful
+    const std::size_t n_batches {20};
+    const int min_av_steps {
+        std::max(check_interval, static_cast<int>(5 * n_batches))};
+
+    // Equilibrate the system for at most mcs_eq steps
+    vec1d e_series {};
+    int eq_steps {0};
+    while (eq_steps < parameters.mcs_eq) {
       simulation_model.update_model_system(T);
       simulation_model.update_model_records();
+      eq_steps++;
+      if (is_stop_rule_met(simulation_model)) {
+        break;
+      }
+      if (parameters.auto_equilibration) {
+        e_series.push_back(simulation_model.get_model_energy());
+        if (eq_steps % check_interval == 0
+            and statistics_space::is_equilibrated(e_series))
+        {
+          break;
+        }
+      }
     }
     simulation_model.save_model_records(T);
+    if (run_stopped) {
+      last_sweeps = eq_steps;
+      return;
+    }
 
     // Depending on the options in the mc_params structure, initialize the
     // containers that will store the MC averages
     simulation_model.initialize_model_averages();
 
+    // In the microcanonical mode, the system equilibrated at T is handed to
+    // a demon holding its mean energy at T: T for a continuous demon, or
+    // step / (exp(step / T) - 1) rounded to a multiple of step otherwise
+    const bool microcanonical {T <= parameters.microcanonical_T};
+    if (microcanonical) {
+      const double demon_step {parameters.demon_energy_step};
+      double demon_energy {T};
+      if (demon_step > 0.0) {
+        demon_energy = demon_step
+                       * std::round(1.0 / std::expm1(demon_step / T));
+      }
+      simulation_model.set_model_demon(true, demon_energy);
+    }
+
     // Collect the averages
-    for(int step=0;step<parameters.mcs_av;step++){
+    e_av_measured = 0.0;
+    e2_av_measured = 0.0;
+    e_series.clear();
+    double demon_av {0.0};
+    int av_steps {0};
+    while (av_steps < parameters.mcs_av) {
       simulation_model.update_model_system(T);
       simulation_model.update_model_averages(T);
+      double e {simulation_model.get_model_energy()};
+      e_av_measured += e;
+      e2_av_measured += e * e;
+      demon_av += simulation_model.get_model_demon_energy();
+      av_steps++;
+      if (is_stop_rule_met(simulation_model)) {
+        break;
+      }
+      if (parameters.e_error_target > 0.0) {
+        e_series.push_back(e);
+        if (av_steps >= min_av_steps and av_steps % check_interval == 0) {
+          double e_error {
+              statistics_space::batch_means_error(e_series, n_batches)};
+          if (e_error >= 0.0 and e_error <= parameters.e_error_target) {
+            break;
+          }
+        }
+      }
+    }
+    if (av_steps > 0) {
+      e_av_measured /= av_steps;
+      e2_av_measured /= av_steps;
+      demon_av /= av_steps;
+    }
+    if (microcanonical) {
+      simulation_model.set_model_demon(false, 0.0);
+      save_demon_temperature(T, demon_av);
+    }
+    last_sweeps = static_cast<long>(eq_steps) + av_steps;
+
+    if (parameters.auto_equilibration or parameters.e_error_target > 0.0) {
+      std::cout << "T = " << T << ": " << eq_steps
+                << " equilibration steps, " << av_steps
+                << " averaging steps\n";
     }
 
     /*Save averages to the files*/
-    simulation_model.save_model_averages(T,parameters.mcs_av);
+    simulation_model.save_model_averages(T,av_steps);
+  }
+
+  void mc::save_demon_temperature(double T, double demon_av){
+    /*
+     * The demon energy is Boltzmann distributed at the temperature of the
+     * system, so T follows from its mean: T = <E_d> for a continuous demon,
+     * and T = step / ln(1 + step / <E_d>) for a demon of energies multiple of
+     * step
+     */
+    const double demon_step {parameters.demon_energy_step};
+    double T_demon {demon_av};
+    if (demon_step > 0.0) {
+      T_demon = demon_av > 0.0 ? demon_step / std::log1p(demon_step / demon_av)
+                               : 0.0;
+    }
+    demon_records.push_back({T, demon_av, T_demon});
+    std::cout << "Demon temperature at T = " << T << ": " << T_demon << '\n';
+    std::string save_loc {parameters.final_structure_address
+                          + "demon_temperatures.dat"};
+    io_space::save_vector(demon_records,
+                          static_cast<int>(demon_records.size()),
+                          3,
+                          save_loc);
+  }
+
+  void mc::continuous_scan(model_space::model &simulation_model){
+
+    /*
+     * The temperature follows the cooling law continuously: the schedule
+     * variable (T, log10(T) or 1/T depending on the cooling schedule) goes
+     * linearly from its initial to its final value over sweep_budget lattice
+     * updates, and changes every sweeps_per_update of them. There is no
+     * equilibration: the energy is streamed with the temperature after every
+     * update, and the averages are binned into n_windows consecutive windows
+     * of equal length.
+     */
+    const long n_sweeps {std::max(parameters.sweep_budget, 1L)};
+    const long sweeps_per_update {
+        std::max(static_cast<long>(parameters.sweeps_per_update), 1L)};
+    const long n_windows {std::clamp(
+        static_cast<long>(parameters.n_windows), 1L, n_sweeps)};
+    const double x_i {T_array.front()};
+    const double x_f {T_array.back()};
+    // Number of temperature changes over the run
+    const long n_updates {(n_sweeps - 1) / sweeps_per_update};
+
+    std::string stream_output {parameters.final_structure_address
+                               + "continuous_annealing.dat"};
+    std::ofstream stream_f {stream_output};
+    std::string windows_output {parameters.final_structure_address
+                                + "continuous_averages.dat"};
+    std::ofstream windows_f {windows_output};
+    if (!stream_f or !windows_f) {
+      std::cerr << "Could not open the continuous annealing outputs in "
+                << parameters.final_structure_address << '\n';
+      exit(1);
+    }
+    stream_f << "# sweep T E\n";
+    windows_f << "# T_min T_max <T> <E> <E^2> n_sweeps\n";
+
+    long sweep {0};
+    for (long window = 0; window < n_windows; window++) {
+      long window_end {(window + 1) * n_sweeps / n_windows};
+      double T_sum {0.0};
+      double T_min {HUGE_VAL};
+      double T_max {-HUGE_VAL};
+      double e_sum {0.0};
+      double e2_sum {0.0};
+      long n_window_sweeps {0};
+
+      simulation_model.initialize_model_averages();
+      for (; sweep < window_end; sweep++) {
+        double progress {n_updates > 0 ? static_cast<double>(
+                                             sweep / sweeps_per_update)
+                                             / static_cast<double>(n_updates)
+                                       : 1.0};
+        double T {apply_cooling_law(x_i + (x_f - x_i) * progress)};
+
+        simulation_model.update_model_system(T);
+        simulation_model.update_model_records();
+        simulation_model.update_model_averages(T);
+
+        double e {simulation_model.get_model_energy()};
+        stream_f << sweep << ' ' << T << ' ' << e << '\n';
+        T_sum += T;
+        T_min = std::min(T_min, T);
+        T_max = std::max(T_max, T);
+        e_sum += e;
+        e2_sum += e * e;
+        n_window_sweeps++;
+        if (is_stop_rule_met(simulation_model)) {
+          sweep++;
+          break;
+        }
+      }
+
+      double n_window_d {static_cast<double>(n_window_sweeps)};
+      double T_mean {T_sum / n_window_d};
+      windows_f << T_min << ' ' << T_max << ' ' << T_mean << ' '
+                << e_sum / n_window_d << ' ' << e2_sum / n_window_d << ' '
+                << n_window_sweeps << '\n';
+      simulation_model.save_model_records(T_mean);
+      simulation_model.save_model_averages(T_mean,
+                                           static_cast<int>(n_window_sweeps));
+
+      if(parameters.checkpoint_option){
+        std::string save_loc {parameters.checkpoint_address + "structure_"
+                              + std::to_string(window) + ".dat"};
+        simulation_model.save_model_state(save_loc);
+      }
+      std::cout << "Energy at T = " << T_mean << ": ";
+      simulation_model.print_model_energy();
+      std::cout << '\n' ;
+      if (run_stopped) {
+        break;
+      }
+    }
+    stream_f.close();
+    windows_f.close();
+
+    if (parameters.final_quench) {
+      quench(simulation_model);
+    }
+    save_final_state(simulation_model);
+  }
+
+  bool mc::is_stop_rule_met(model_space::model &simulation_model){
+    /*
+     * Called after every lattice update. Counting the sweeps without accepted
+     * moves is a comparison of counters; the other rules are only evaluated
+     * every stop_check_interval updates, as finding the largest cluster
+     * needs a pass over the lattice.
+     */
+    if (run_stopped) {
+      return true;
+    }
+
+    if (parameters.stop_frozen_sweeps > 0) {
+      long n_accepted {simulation_model.get_model_n_accepted_moves()};
+      if (n_accepted != last_n_accepted) {
+        last_n_accepted = n_accepted;
+        frozen_sweeps = 0;
+      }
+      else if (++frozen_sweeps >= parameters.stop_frozen_sweeps) {
+        std::cout << "Stopping: no accepted move for " << frozen_sweeps
+                  << " lattice updates\n";
+        run_stopped = true;
+        return true;
+      }
+    }
+
+    if (parameters.stop_largest_cluster <= 0
+        and parameters.stop_energy_per_particle == -HUGE_VAL) {
+      return false;
+    }
+    if (++sweeps_since_stop_check < parameters.stop_check_interval) {
+      return false;
+    }
+    sweeps_since_stop_check = 0;
+
+    if (parameters.stop_largest_cluster > 0) {
+      int largest_cluster {simulation_model.get_model_largest_cluster()};
+      if (largest_cluster >= parameters.stop_largest_cluster) {
+        std::cout << "Stopping: the largest cluster holds "
+                  << largest_cluster << " particles\n";
+        run_stopped = true;
+        return true;
+      }
+    }
+
+    int n_particles {simulation_model.get_model_n_particles()};
+    if (parameters.stop_energy_per_particle != -HUGE_VAL and n_particles > 0) {
+      double e_per_particle {simulation_model.get_model_energy()
+                             / n_particles};
+      if (e_per_particle <= parameters.stop_energy_per_particle) {
+        std::cout << "Stopping: energy per particle " << e_per_particle
+                  << '\n';
+        run_stopped = true;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void mc::quench(model_space::model &simulation_model){
+
+    std::cout << "Energy before quench: ";
+    simulation_model.print_model_energy();
+    std::cout << '\n';
+
+    long n_moves {simulation_model.quench_model()};
+
+    std::cout << "Energy after " << n_moves << " downhill moves: ";
+    simulation_model.print_model_energy();
+    std::cout << '\n';
+  }
+
+  void mc::transfer_matrix_scan(model_space::model &simulation_model){
+    vec1d temperatures {get_temperatures()};
+    vec2d results {simulation_model.get_model_exact_thermodynamics(
+        temperatures)};
+
+    std::cout << "Exact values per site: T, f, <E>, C, densities\n";
+    for (vec1d& line : results) {
+      for (double value : line) {
+        std::cout << value << ' ';
+      }
+      std::cout << '\n';
+    }
+
+    std::string save_loc {parameters.final_structure_address
+                          + "transfer_matrix.dat"};
+    io_space::save_vector(results,
+                          static_cast<int>(results.size()),
+                          static_cast<int>(results[0].size()),
+                          save_loc);
+  }
+
+  void mc::save_final_state(model_space::model &simulation_model){
+    std::string final_state_save_loc{parameters.final_structure_address +
+                                     "final_structure.dat"};
+    simulation_model.save_model_state(final_state_save_loc);
+
+    if (simulation_model.is_best_state_tracked()) {
+      std::cout << "Best energy met during the run: "
+                << simulation_model.get_model_best_energy() << '\n';
+      std::string best_state_save_loc{parameters.final_structure_address +
+                                      "best_structure.dat"};
+      simulation_model.save_model_best_state(best_state_save_loc);
+    }
+  }
+
+  void mc::lockstep_scan(model_space::model &simulation_model){
+
+    simulation_model.initialize_model_lockstep(parameters.n_lanes);
+    vec1d energies {simulation_model.get_model_lockstep_energies()};
+    std::size_t n_lanes {energies.size()};
+    std::cout << "Updating " << n_lanes << " lanes in lockstep\n";
+
+    // One line per temperature: T followed by the average energy of each lane
+    vec2d lane_records {};
+    std::string records_loc {parameters.final_structure_address
+                             + "lockstep_energies.dat"};
+
+    for (std::size_t i = 0; i < static_cast<std::size_t>(parameters.Nt); i++) {
+
+      double T {get_temperature(i)};
+
+      for (int step = 0; step < parameters.mcs_eq; step++) {
+        simulation_model.update_model_lockstep(T);
+      }
+
+      vec1d e_av(n_lanes, 0.0);
+      for (int step = 0; step < parameters.mcs_av; step++) {
+        simulation_model.update_model_lockstep(T);
+        energies = simulation_model.get_model_lockstep_energies();
+        for (std::size_t lane = 0; lane < n_lanes; lane++) {
+          e_av[lane] += energies[lane];
+        }
+      }
+
+      vec1d record {T};
+      for (std::size_t lane = 0; lane < n_lanes; lane++) {
+        if (parameters.mcs_av > 0) {
+          e_av[lane] /= parameters.mcs_av;
+        }
+        record.push_back(e_av[lane]);
+      }
+      lane_records.push_back(record);
+      io_space::save_vector(lane_records,
+                            static_cast<int>(lane_records.size()),
+                            static_cast<int>(n_lanes) + 1,
+                            records_loc);
+
+      if(parameters.checkpoint_option){
+        for (std::size_t lane = 0; lane < n_lanes; lane++) {
+          std::string save_loc {parameters.checkpoint_address + "structure_"
+                                + std::to_string(i) + "_lane_"
+                                + std::to_string(lane) + ".dat"};
+          simulation_model.save_model_lockstep_state(static_cast<int>(lane),
+                                                     save_loc);
+        }
+      }
+      std::cout << "Lane energies at T = " << T << ": ";
+      array_space::print_vector(std::cout,
+                                simulation_model.get_model_lockstep_energies());
+      std::cout << '\n';
+    }
+
+    for (std::size_t lane = 0; lane < n_lanes; lane++) {
+      std::string final_state_save_loc{parameters.final_structure_address
+                                       + "final_structure_lane_"
+                                       + std::to_string(lane) + ".dat"};
+      simulation_model.save_model_lockstep_state(static_cast<int>(lane),
+                                                 final_state_save_loc);
+    }
   }
 }
@@ -0,0 +1,495 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "mpi_domain.h"
+#include "io_utils.h"
+#include "particles_update.h"
+
+#include <algorithm>
+#include <fstream>
+
+namespace simulation_space{
+
+  namespace {
+    int get_comm_rank(MPI_Comm comm){
+      int rank {};
+      MPI_Comm_rank(comm, &rank);
+      return rank;
+    }
+
+    int get_comm_size(MPI_Comm comm){
+      int size {};
+      MPI_Comm_size(comm, &size);
+      return size;
+    }
+  }
+
+  slab_struct::slab_struct(std::string& model_input, MPI_Comm comm,
+                           int rank, int n_ranks){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream model_f;
+    model_f.open(model_input);
+    if(!model_f){
+      std::cerr << "Could not open JSON model parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_model_params = json::parse(model_f);
+
+    std::string lattice_str {
+        json_model_params["lattice_name"].template get<std::string>()};
+    lattice = geometry_space::get_lattice_from_str(lattice_str);
+    lx = json_model_params["lx"].template get<int>();
+    ly = json_model_params["ly"].template get<int>();
+    lz = json_model_params["lz"].template get<int>();
+    n_sites = lx * ly * lz;
+
+    // Decompose along the slowest axis of the site indices
+    int n_total_layers {};
+    switch (lattice) {
+      case geometry_space::lattice_options::chain:
+        n_total_layers = lx;
+        layer_size = 1;
+        break;
+      case geometry_space::lattice_options::square:
+      case geometry_space::lattice_options::triangular:
+        n_total_layers = ly;
+        layer_size = lx;
+        break;
+      default:
+        n_total_layers = lz;
+        layer_size = lx * ly;
+        break;
+    }
+
+    // Spread the remaining layers over the first ranks
+    int base_layers {n_total_layers / n_ranks};
+    int extra_layers {n_total_layers % n_ranks};
+    n_layers = base_layers + (rank < extra_layers);
+    first_layer = rank * base_layers + std::min(rank, extra_layers);
+    if (base_layers < 2) {
+      if (rank == 0) {
+        std::cerr << "Every rank needs at least 2 layers: " << n_total_layers
+                  << " layers cannot be shared by " << n_ranks << " ranks\n";
+      }
+      MPI_Abort(comm, 1);
+    }
+
+    local_lx = lx;
+    local_ly = ly;
+    local_lz = lz;
+    switch (lattice) {
+      case geometry_space::lattice_options::chain:
+        local_lx = n_layers + 2;
+        break;
+      case geometry_space::lattice_options::square:
+      case geometry_space::lattice_options::triangular:
+        local_ly = n_layers + 2;
+        break;
+      default:
+        local_lz = n_layers + 2;
+        break;
+    }
+  }
+
+  mpi_domain::mpi_domain(std::string& model_input, std::string& mc_input,
+                         MPI_Comm communicator)
+      : comm {communicator}
+      , rank {get_comm_rank(communicator)}
+      , n_ranks {get_comm_size(communicator)}
+      , rank_up {(rank + 1) % n_ranks}
+      , rank_down {(rank - 1 + n_ranks) % n_ranks}
+      , parameters {particles_space::model_parameters_struct(model_input)}
+      , mc_parameters {mc_parameters_struct(mc_input, rank == 0)}
+      , slab {slab_struct(model_input, communicator, rank, n_ranks)}
+      , geometry {slab.lattice, slab.local_lx, slab.local_ly, slab.local_lz}
+  {
+    mc annealing {mc_input, false};
+    T_array = annealing.get_temperatures();
+
+    std::random_device dev;
+    parameters.rng.seed(dev() + static_cast<unsigned int>(rank));
+
+    state.n_types = parameters.n_types;
+    state.n_orientations = geometry.get_n_orientations();
+    state.n_neighbours = geometry.get_n_neighbours();
+    state.n_states = state.n_types * state.n_orientations;
+    state.n_sites = geometry.get_n_sites();
+
+    if (parameters.move_probas[particles_space::mc_moves::insert_remove] > 0) {
+      std::cerr << "insert_remove moves are not supported by the MPI build\n";
+      MPI_Abort(comm, 1);
+    }
+    if (mc_parameters.has_stop_rule()) {
+      std::cerr << "The stopping rules are not supported by the MPI build\n";
+      MPI_Abort(comm, 1);
+    }
+
+    initialize_slab();
+    exchange_halos();
+
+    interactions.couplings = parameters.couplings;
+    interactions.energy = 0.0;
+    int first_owned {slab.layer_size};
+    int last_owned {slab.layer_size * (slab.n_layers + 1)};
+    double owned_energy {0.0};
+    for (int site = first_owned; site < last_owned; site++) {
+      owned_energy += particles_space::get_site_energy(
+          state, interactions, geometry, site);
+    }
+    // Bonds are counted once from each end, on this rank or on a neighbour
+    MPI_Allreduce(
+        &owned_energy, &initial_energy, 1, MPI_DOUBLE, MPI_SUM, comm);
+    initial_energy /= 2;
+  }
+
+  void mpi_domain::initialize_slab(){
+    std::size_t n_local {static_cast<std::size_t>(state.n_sites)};
+    std::size_t layer_size {static_cast<std::size_t>(slab.layer_size)};
+    std::size_t n_owned {layer_size * static_cast<std::size_t>(slab.n_layers)};
+    std::size_t first_global {layer_size
+                              * static_cast<std::size_t>(slab.first_layer)};
+
+    vec1i owned_types {};
+    vec1i owned_orientations {};
+    if (parameters.initialize_option == "from_file") {
+      vec1i types {};
+      vec1i orientations {};
+      particles_space::read_state_file(types, orientations,
+                                       parameters.state_input);
+      if (types.size() != static_cast<std::size_t>(slab.n_sites)
+          or orientations.size() != static_cast<std::size_t>(slab.n_sites)) {
+        std::cerr << "The structure in " << parameters.state_input
+                  << " does not match the lattice size\n";
+        MPI_Abort(comm, 1);
+      }
+      auto first {static_cast<std::ptrdiff_t>(first_global)};
+      auto last {static_cast<std::ptrdiff_t>(first_global + n_owned)};
+      owned_types.assign(types.begin() + first, types.begin() + last);
+      owned_orientations.assign(orientations.begin() + first,
+                                orientations.begin() + last);
+    }
+    else if (parameters.initialize_option == "random") {
+      // Particles of each type whose rank in the whole lattice falls in
+      // the slab, so that the totals add up exactly
+      particles_space::model_parameters_struct slab_parameters {parameters};
+      long n_sites {slab.n_sites};
+      long start {static_cast<long>(first_global)};
+      long end {start + static_cast<long>(n_owned)};
+      for (std::size_t type = 0; type < parameters.n_particles.size(); type++) {
+        long n_particles {parameters.n_particles[type]};
+        slab_parameters.n_particles[type] = static_cast<int>(
+            n_particles * end / n_sites - n_particles * start / n_sites);
+      }
+      particles_space::state_struct slab_state {state};
+      slab_state.n_sites = static_cast<int>(n_owned);
+      particles_space::initialize_state_random_fixed_particle_numbers(
+          owned_types, owned_orientations, slab_state, slab_parameters);
+      parameters.rng = slab_parameters.rng;
+    }
+    else {
+      std::cerr << "Incorrect initialization option: ''"
+                << parameters.initialize_option << "''\n";
+      MPI_Abort(comm, 1);
+    }
+
+    // Halos start empty and are filled by the first exchange
+    vec1i types(n_local, 0);
+    vec1i orientations(n_local, -1);
+    std::copy(owned_types.begin(), owned_types.end(),
+              types.begin() + static_cast<std::ptrdiff_t>(layer_size));
+    std::copy(owned_orientations.begin(), owned_orientations.end(),
+              orientations.begin() + static_cast<std::ptrdiff_t>(layer_size));
+    state.lattice_sites =
+        particles_space::SiteVector(types, orientations, state.n_orientations);
+  }
+
+  void mpi_domain::exchange_halos(){
+    int layer_size {slab.layer_size};
+    std::size_t buffer_size {2 * static_cast<std::size_t>(layer_size)};
+    vec1i send_buffer(buffer_size);
+    vec1i receive_buffer(buffer_size);
+
+    auto pack = [&](int layer){
+      for (int i = 0; i < layer_size; i++) {
+        std::size_t u_i {static_cast<std::size_t>(i)};
+        int site {layer * layer_size + i};
+        send_buffer[2 * u_i] = state.lattice_sites.get_type(site);
+        send_buffer[2 * u_i + 1] = state.lattice_sites.get_orientation(site);
+      }
+    };
+    auto unpack = [&](int layer){
+      for (int i = 0; i < layer_size; i++) {
+        std::size_t u_i {static_cast<std::size_t>(i)};
+        state.lattice_sites.set_site(layer * layer_size + i,
+                                     receive_buffer[2 * u_i],
+                                     receive_buffer[2 * u_i + 1]);
+      }
+    };
+
+    // First owned layer goes to the upper halo of the rank below
+    pack(1);
+    MPI_Sendrecv(send_buffer.data(), 2 * layer_size, MPI_INT, rank_down, 0,
+                 receive_buffer.data(), 2 * layer_size, MPI_INT, rank_up, 0,
+                 comm, MPI_STATUS_IGNORE);
+    unpack(slab.n_layers + 1);
+
+    // Last owned layer goes to the lower halo of the rank above
+    pack(slab.n_layers);
+    MPI_Sendrecv(send_buffer.data(), 2 * layer_size, MPI_INT, rank_up, 1,
+                 receive_buffer.data(), 2 * layer_size, MPI_INT, rank_down, 1,
+                 comm, MPI_STATUS_IGNORE);
+    unpack(0);
+  }
+
+  void mpi_domain::update_slab(double T){
+    int layer_size {slab.layer_size};
+    int middle_layer {1 + slab.n_layers / 2};
+    update_half(layer_size, middle_layer * layer_size, T);
+    exchange_halos();
+    update_half(middle_layer * layer_size,
+                (slab.n_layers + 1) * layer_size, T);
+    shift_slab();
+  }
+
+  void mpi_domain::shift_slab(){
+    // The upper halo already holds the first layer of the rank above, which
+    // the second half does not touch, and the first owned layer becomes the
+    // lower halo of this rank
+    int n_shifted {slab.layer_size * (slab.n_layers + 1)};
+    for (int site = 0; site < n_shifted; site++) {
+      int source {site + slab.layer_size};
+      state.lattice_sites.set_site(site,
+                                   state.lattice_sites.get_type(source),
+                                   state.lattice_sites.get_orientation(source));
+    }
+    exchange_halos();
+    layer_shift = (layer_shift + 1) % (slab.n_sites / slab.layer_size);
+  }
+
+  void mpi_domain::update_half(int first_site, int last_site, double T){
+    active_full_sites.clear();
+    for (int site = first_site; site < last_site; site++) {
+      if (!state.lattice_sites.is_empty(site)) {
+        active_full_sites.push_back(site);
+      }
+    }
+    if (active_full_sites.empty()) {
+      return;
+    }
+
+    int_dist position_dist(0, static_cast<int>(active_full_sites.size()) - 1);
+    for (int i = first_site; i < last_site; i++) {
+      particles_space::mc_moves chosen_move {
+          particles_space::pick_random_move(parameters)};
+      std::size_t position {
+          static_cast<std::size_t>(position_dist(parameters.rng))};
+      local_energy_change += attempt_local_move(
+          chosen_move, position, first_site, last_site, T);
+    }
+  }
+
+  double mpi_domain::attempt_local_move(particles_space::mc_moves chosen_move,
+                                        std::size_t position,
+                                        int first_site,
+                                        int last_site,
+                                        double T){
+    using particles_space::mc_moves;
+    int site {active_full_sites[position]};
+
+    switch (chosen_move) {
+      case mc_moves::rotate: {
+        double delta_e {-particles_space::get_site_energy(
+            state, interactions, geometry, site)};
+        int old_orientation {particles_space::perform_random_rotation(
+            state, parameters, site)};
+        delta_e += particles_space::get_site_energy(
+            state, interactions, geometry, site);
+        if (particles_space::is_move_accepted(delta_e, T, parameters)) {
+          return delta_e;
+        }
+        state.lattice_sites.set_orientation(site, old_orientation);
+        return 0.0;
+      }
+      case mc_moves::mutate: {
+        double delta_e {-particles_space::get_site_energy(
+            state, interactions, geometry, site)};
+        int_dist type_dist {0, state.n_types - 1};
+        int old_type {state.lattice_sites.get_type(site)};
+        int new_type {type_dist(parameters.rng)};
+        while (new_type == old_type)
+          new_type = type_dist(parameters.rng);
+        state.lattice_sites.set_type(site, new_type);
+        delta_e += particles_space::get_site_energy(
+            state, interactions, geometry, site);
+        if (particles_space::is_move_accepted(delta_e, T, parameters)) {
+          return delta_e;
+        }
+        state.lattice_sites.set_type(site, old_type);
+        return 0.0;
+      }
+      case mc_moves::heat_bath_rotate:
+      case mc_moves::heat_bath_mutate: {
+        vec1d& state_energies {interactions.site_state_energies};
+        particles_space::get_site_state_energies(
+            state, interactions, geometry, site, state_energies);
+        int type {state.lattice_sites.get_type(site)};
+        int old_state {state.lattice_sites.get_orientation(site)
+                       + state.n_orientations * type};
+        bool rotate_only {chosen_move == mc_moves::heat_bath_rotate};
+        int first_state {rotate_only ? state.n_orientations * type : 0};
+        int n_candidates {rotate_only ? state.n_orientations
+                                      : state.n_states};
+        int new_state {particles_space::sample_heat_bath_state(
+            state_energies, first_state, n_candidates, T, parameters)};
+        state.lattice_sites.set_site(site,
+                                     new_state / state.n_orientations,
+                                     new_state % state.n_orientations);
+        parameters.n_accepted_moves += (new_state != old_state);
+        return state_energies[static_cast<std::size_t>(new_state)]
+            - state_energies[static_cast<std::size_t>(old_state)];
+      }
+      default:
+        break;
+    }
+
+    // Moves with a neighbouring site, which must belong to the active half
+    int_dist bond_dist(0, geometry.get_n_neighbours() - 1);
+    int bond {bond_dist(parameters.rng)};
+    int neighbour {geometry.get_neighbour(site, bond)};
+    if (neighbour < first_site or neighbour >= last_site) {
+      return 0.0;
+    }
+    bool neighbour_empty {state.lattice_sites.is_empty(neighbour)};
+    bool hop {chosen_move == mc_moves::swap_empty_full
+              or chosen_move == mc_moves::rotate_and_swap_w_empty};
+    if (hop != neighbour_empty) {
+      return 0.0;
+    }
+
+    double delta_e {-particles_space::measure_pair_energy(
+        site, neighbour, bond, state, interactions, geometry)};
+    int old_orientation {state.lattice_sites.get_orientation(site)};
+    if (chosen_move == mc_moves::rotate_and_swap_w_empty) {
+      particles_space::perform_random_rotation(state, parameters, site);
+    }
+    state.lattice_sites.swap_sites(site, neighbour);
+    delta_e += particles_space::measure_pair_energy(
+        site, neighbour, bond, state, interactions, geometry);
+
+    if (particles_space::is_move_accepted(delta_e, T, parameters)) {
+      if (hop) {
+        active_full_sites[position] = neighbour;
+      }
+      return delta_e;
+    }
+    state.lattice_sites.swap_sites(site, neighbour);
+    state.lattice_sites.set_orientation(site, old_orientation);
+    return 0.0;
+  }
+
+  double mpi_domain::reduce_energy(){
+    double energy_change {0.0};
+    MPI_Reduce(&local_energy_change, &energy_change, 1, MPI_DOUBLE, MPI_SUM, 0,
+               comm);
+    return initial_energy + energy_change;
+  }
+
+  void mpi_domain::save_global_state(std::string state_output){
+    std::size_t layer_size {static_cast<std::size_t>(slab.layer_size)};
+    int n_owned {slab.layer_size * slab.n_layers};
+    vec1i owned_types(static_cast<std::size_t>(n_owned));
+    vec1i owned_orientations(static_cast<std::size_t>(n_owned));
+    for (int i = 0; i < n_owned; i++) {
+      int site {slab.layer_size + i};
+      owned_types[static_cast<std::size_t>(i)] =
+          state.lattice_sites.get_type(site);
+      owned_orientations[static_cast<std::size_t>(i)] =
+          state.lattice_sites.get_orientation(site);
+    }
+
+    // Slabs are ordered by rank, so the gathered arrays are in site order up
+    // to the layer_shift translation
+    vec1i counts(static_cast<std::size_t>(n_ranks));
+    vec1i displacements(static_cast<std::size_t>(n_ranks));
+    MPI_Gather(&n_owned, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    for (std::size_t r = 1; r < counts.size(); r++) {
+      displacements[r] = displacements[r - 1] + counts[r - 1];
+    }
+
+    std::size_t n_global {rank == 0 ? static_cast<std::size_t>(slab.n_sites)
+                                    : layer_size};
+    vec1i types(n_global);
+    vec1i orientations(n_global);
+    MPI_Gatherv(owned_types.data(), n_owned, MPI_INT, types.data(),
+                counts.data(), displacements.data(), MPI_INT, 0, comm);
+    MPI_Gatherv(owned_orientations.data(), n_owned, MPI_INT,
+                orientations.data(), counts.data(), displacements.data(),
+                MPI_INT, 0, comm);
+
+    if (rank == 0) {
+      int n_total_layers {slab.n_sites / slab.layer_size};
+      auto middle {static_cast<std::ptrdiff_t>(
+          (n_total_layers - layer_shift) % n_total_layers * slab.layer_size)};
+      std::rotate(types.begin(), types.begin() + middle, types.end());
+      std::rotate(orientations.begin(), orientations.begin() + middle,
+                  orientations.end());
+      particles_space::state_struct global_state {};
+      global_state.n_sites = slab.n_sites;
+      global_state.lattice_sites = particles_space::SiteVector(
+          types, orientations, state.n_orientations);
+      particles_space::save_state(global_state, state_output);
+    }
+  }
+
+  void mpi_domain::anneal(){
+    if (rank == 0) {
+      std::cout << "Annealing on " << n_ranks << " ranks\n";
+      std::cout << "Initial energy: " << initial_energy << '\n';
+    }
+
+    std::string energies_output {mc_parameters.final_structure_address
+                                 + "mpi_energies.dat"};
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+      double T {T_array[i]};
+
+      for (int step = 0; step < mc_parameters.mcs_eq; step++) {
+        update_slab(T);
+      }
+
+      double e_av {0.0};
+      double e2_av {0.0};
+      for (int step = 0; step < mc_parameters.mcs_av; step++) {
+        update_slab(T);
+        double e {reduce_energy()};
+        e_av += e;
+        e2_av += e * e;
+      }
+
+      if (mc_parameters.checkpoint_option) {
+        save_global_state(mc_parameters.checkpoint_address + "structure_"
+                          + std::to_string(i) + ".dat");
+      }
+
+      double e {reduce_energy()};
+      if (rank == 0) {
+        if (mc_parameters.mcs_av > 0) {
+          e_av /= mc_parameters.mcs_av;
+          e2_av /= mc_parameters.mcs_av;
+        }
+        energy_records.push_back({T, e_av, e2_av});
+        io_space::save_vector(energy_records,
+                              static_cast<int>(energy_records.size()),
+                              3,
+                              energies_output);
+        std::cout << "Energy at T = " << T << ": " << e << '\n';
+      }
+    }
+
+    save_global_state(mc_parameters.final_structure_address
+                      + "final_structure.dat");
+  }
+}
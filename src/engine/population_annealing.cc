@@ -0,0 +1,294 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "population_annealing.h"
+#include "io_utils.h"
+
+#include <algorithm>
+
+namespace simulation_space{
+
+  population_parameters_struct::population_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    n_replicas = json_mc_params["n_replicas"].template get<int>();
+    if (n_replicas < 1) {
+      std::cerr << "Population annealing needs at least one replica\n";
+      exit(1);
+    }
+
+    population_output = mc_parameters.final_structure_address
+                        + "population_annealing.dat";
+    if (json_mc_params.contains("population_output")) {
+      population_output =
+          json_mc_params["population_output"].template get<std::string>();
+    }
+    if (json_mc_params.contains("restart_step")) {
+      restart_step = json_mc_params["restart_step"].template get<int>();
+      if (restart_step >= 0 and !mc_parameters.checkpoint_option) {
+        std::cerr << "Restarting a population requires checkpoint_option\n";
+        exit(1);
+      }
+    }
+  }
+
+  population_annealing::population_annealing(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {population_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+      , pool {mc_params.n_threads}
+  {
+    std::random_device dev;
+    rng.seed(dev());
+  }
+
+  void population_annealing::anneal(model_space::model &simulation_model){
+
+    std::size_t n_replicas {static_cast<std::size_t>(parameters.n_replicas)};
+
+    // Every replica starts from the input configuration with its own seed
+    replicas.clear();
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      replicas.push_back(simulation_model);
+      replicas.back().reseed_model_rng(static_cast<unsigned int>(rng()));
+    }
+
+    std::cout << "Annealing a population of " << n_replicas
+              << " replicas on " << pool.get_n_threads() << " threads\n";
+
+    double e_av {0.0};
+    double e2_av {0.0};
+    std::size_t first_step {0};
+
+    if (parameters.restart_step >= 0) {
+      // The checkpointed population is already equilibrated at its
+      // temperature, carry on from the next step
+      first_step = static_cast<std::size_t>(parameters.restart_step) + 1;
+      load_population(first_step - 1);
+      load_population_records(first_step);
+    }
+    else {
+      beta_f = 0.0;
+      sweep_replicas(T_array[0], mc_parameters.mcs_eq, mc_parameters.mcs_av,
+                     e_av, e2_av);
+      population_records.push_back(
+          {T_array[0], e_av, e2_av, beta_f,
+           static_cast<double>(n_replicas)});
+      save_population_records();
+      save_population(0);
+      first_step = 1;
+    }
+
+    for (std::size_t i = first_step; i < T_array.size(); i++) {
+
+      double T {T_array[i]};
+      double n_eff {resample(1.0 / T - 1.0 / T_array[i - 1])};
+
+      sweep_replicas(T, mc_parameters.mcs_eq, mc_parameters.mcs_av,
+                     e_av, e2_av);
+
+      population_records.push_back({T, e_av, e2_av, beta_f, n_eff});
+      save_population_records();
+      save_population(i);
+
+      std::cout << "Population energy at T = " << T << ": " << e_av
+                << ", effective population size: " << n_eff << '\n';
+    }
+    save_population_records();
+
+    // Save every replica, and keep the lowest-energy one as the final
+    // structure
+    std::size_t best {0};
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      std::string save_loc {mc_parameters.final_structure_address
+                            + "final_structure_replica_" + std::to_string(r)
+                            + ".dat"};
+      replicas[r].save_model_state(save_loc);
+      if (replicas[r].get_model_energy() < replicas[best].get_model_energy()) {
+        best = r;
+      }
+    }
+    simulation_model.copy_model_state(replicas[best]);
+
+    std::string final_state_save_loc{mc_parameters.final_structure_address +
+                                     "final_structure.dat"};
+    simulation_model.save_model_state(final_state_save_loc);
+  }
+
+  void population_annealing::sweep_replicas(double T, int n_sweeps,
+                                            int n_av_sweeps,
+                                            double& e_av, double& e2_av){
+    std::size_t n_replicas {replicas.size()};
+    vec1d replica_e_av(n_replicas, 0.0);
+    vec1d replica_e2_av(n_replicas, 0.0);
+
+    pool.parallel_for(parameters.n_replicas, [&](int r){
+      std::size_t u_r {static_cast<std::size_t>(r)};
+      model_space::model& replica {replicas[u_r]};
+      for (int step = 0; step < n_sweeps; step++) {
+        replica.update_model_system(T);
+      }
+      for (int step = 0; step < n_av_sweeps; step++) {
+        replica.update_model_system(T);
+        double e {replica.get_model_energy()};
+        replica_e_av[u_r] += e;
+        replica_e2_av[u_r] += e * e;
+      }
+      if (n_av_sweeps > 0) {
+        replica_e_av[u_r] /= n_av_sweeps;
+        replica_e2_av[u_r] /= n_av_sweeps;
+      }
+      else {
+        double e {replica.get_model_energy()};
+        replica_e_av[u_r] = e;
+        replica_e2_av[u_r] = e * e;
+      }
+    });
+
+    e_av = 0.0;
+    e2_av = 0.0;
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      e_av += replica_e_av[r];
+      e2_av += replica_e2_av[r];
+    }
+    e_av /= static_cast<double>(n_replicas);
+    e2_av /= static_cast<double>(n_replicas);
+  }
+
+  double population_annealing::resample(double delta_beta){
+    std::size_t n_replicas {replicas.size()};
+    double r_replicas {static_cast<double>(n_replicas)};
+
+    // Weights are computed relative to the energy of the heaviest replica to
+    // avoid overflows: the lowest energy when cooling, the highest when
+    // heating. With insert_remove moves, the energies include the chemical
+    // potential term -sum_t mu_t N_t, and F is the grand potential
+    vec1d energies(n_replicas);
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      energies[r] = replicas[r].get_model_grand_energy();
+    }
+    double e_ref {delta_beta >= 0
+                      ? *std::min_element(energies.begin(), energies.end())
+                      : *std::max_element(energies.begin(), energies.end())};
+
+    vec1d weights(n_replicas);
+    double sum_w {0.0};
+    double sum_w2 {0.0};
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      weights[r] = std::exp(-delta_beta * (energies[r] - e_ref));
+      sum_w += weights[r];
+      sum_w2 += weights[r] * weights[r];
+    }
+
+    // beta_new * F_new = beta_old * F_old - ln < exp(-delta_beta * E) >
+    beta_f -= std::log(sum_w / r_replicas) - delta_beta * e_ref;
+    double n_eff {sum_w * sum_w / sum_w2};
+
+    // Systematic resampling: replica r gets floor(C_r + u) - floor(C_{r-1} + u)
+    // copies, with C_r the cumulative normalised weight times n_replicas
+    std::uniform_real_distribution<double> u_dist(0.0, 1.0);
+    double u {u_dist(rng)};
+    double cumulative {0.0};
+    double previous_floor {std::floor(u)};
+    std::vector<std::size_t> free_slots {};
+    std::vector<std::size_t> sources {};
+    for (std::size_t r = 0; r < n_replicas; r++) {
+      // Rounding errors must not change the total number of copies: the
+      // cumulative weight never exceeds n_replicas and ends on it
+      cumulative = std::min(cumulative + weights[r] / sum_w * r_replicas,
+                            r_replicas);
+      if (r == n_replicas - 1) {
+        cumulative = r_replicas;
+      }
+      double current_floor {std::floor(cumulative + u)};
+      int n_copies {static_cast<int>(current_floor - previous_floor)};
+      previous_floor = current_floor;
+      if (n_copies == 0) {
+        free_slots.push_back(r);
+      }
+      for (int copy = 1; copy < n_copies; copy++) {
+        sources.push_back(r);
+      }
+    }
+    // The copies add up to n_replicas, so every discarded replica is
+    // replaced by one extra copy
+    std::size_t n_moves {free_slots.size()};
+
+    // Only the discarded replicas are overwritten, by copies of the state
+    // arrays of the duplicated ones. Sources are never overwritten, so the
+    // copies can run in parallel
+    pool.parallel_for(static_cast<int>(n_moves), [&](int m){
+      std::size_t u_m {static_cast<std::size_t>(m)};
+      replicas[free_slots[u_m]].copy_model_state(replicas[sources[u_m]]);
+    });
+
+    return n_eff;
+  }
+
+  void population_annealing::save_population(std::size_t step){
+    if (!mc_parameters.checkpoint_option) {
+      return;
+    }
+    std::string prefix {mc_parameters.checkpoint_address + "population_"
+                        + std::to_string(step)};
+    for (std::size_t r = 0; r < replicas.size(); r++) {
+      std::string save_loc {prefix + "_replica_" + std::to_string(r) + ".dat"};
+      replicas[r].save_model_state(save_loc);
+    }
+    vec1d population_state {T_array[step], beta_f};
+    std::string save_loc {prefix + ".dat"};
+    io_space::save_vector(population_state, 2, save_loc);
+  }
+
+  void population_annealing::load_population(std::size_t step){
+    std::string prefix {mc_parameters.checkpoint_address + "population_"
+                        + std::to_string(step)};
+    for (std::size_t r = 0; r < replicas.size(); r++) {
+      replicas[r].load_model_state(prefix + "_replica_" + std::to_string(r)
+                                   + ".dat");
+    }
+    vec1d population_state {};
+    std::string load_loc {prefix + ".dat"};
+    io_space::read_vector(population_state, 2, load_loc);
+    beta_f = population_state[1];
+    std::cout << "Restarting population from T = " << population_state[0]
+              << '\n';
+  }
+
+  void population_annealing::load_population_records(std::size_t n_steps){
+    population_records.clear();
+    std::ifstream records_f {parameters.population_output};
+    if (!records_f) {
+      std::cout << "No earlier records in " << parameters.population_output
+                << ", the output starts at the restart\n";
+      return;
+    }
+    records_f.close();
+    io_space::read_vector(population_records,
+                          static_cast<int>(n_steps),
+                          5,
+                          parameters.population_output);
+  }
+
+  void population_annealing::save_population_records(){
+    io_space::save_vector(population_records,
+                          static_cast<int>(population_records.size()),
+                          5,
+                          parameters.population_output);
+  }
+}
@@ -0,0 +1,178 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "simulated_tempering.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace simulation_space{
+
+  tempering_parameters_struct::tempering_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (json_mc_params.contains("tempering_interval")) {
+      interval = json_mc_params["tempering_interval"].template get<int>();
+    }
+    if (json_mc_params.contains("tempering_f_initial")) {
+      f_initial = json_mc_params["tempering_f_initial"].template get<double>();
+    }
+    if (json_mc_params.contains("tempering_f_final")) {
+      f_final = json_mc_params["tempering_f_final"].template get<double>();
+    }
+    if (json_mc_params.contains("tempering_flatness")) {
+      flatness = json_mc_params["tempering_flatness"].template get<double>();
+    }
+    learning_sweeps = static_cast<long>(mc_parameters.Nt)
+                      * mc_parameters.mcs_eq;
+    if (json_mc_params.contains("tempering_learning_sweeps")) {
+      learning_sweeps =
+          json_mc_params["tempering_learning_sweeps"].template get<long>();
+    }
+    output = mc_parameters.final_structure_address
+             + "simulated_tempering.dat";
+    if (json_mc_params.contains("tempering_output")) {
+      output = json_mc_params["tempering_output"].template get<std::string>();
+    }
+    if (interval < 1) {
+      std::cerr << "tempering_interval must be positive\n";
+      exit(1);
+    }
+  }
+
+  simulated_tempering::simulated_tempering(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {tempering_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+  {
+    std::random_device dev;
+    rng.seed(dev());
+  }
+
+  void simulated_tempering::run(model_space::model &simulation_model){
+
+    std::size_t n_temperatures {T_array.size()};
+    if (n_temperatures < 2) {
+      std::cerr << "Simulated tempering needs at least two temperatures\n";
+      exit(1);
+    }
+    current = 0;
+    log_weights.assign(n_temperatures, 0.0);
+
+    // Learning stage
+    double f {parameters.f_initial};
+    visits.assign(n_temperatures, 0);
+    long sweeps {0};
+    while (f >= parameters.f_final and sweeps < parameters.learning_sweeps) {
+      for (int step = 0; step < parameters.interval; step++) {
+        simulation_model.update_model_system(T_array[current]);
+      }
+      sweeps += parameters.interval;
+      attempt_hop(simulation_model);
+      visits[current]++;
+      log_weights[current] -= f;
+      if (is_histogram_flat()) {
+        f /= 2;
+        visits.assign(n_temperatures, 0);
+        std::cout << "Wang-Landau factor lowered to " << f << " after "
+                  << sweeps << " lattice updates\n";
+      }
+    }
+    if (f >= parameters.f_final) {
+      std::cerr << "Warning: the Wang-Landau factor is still " << f
+                << " at the end of the learning stage\n";
+    }
+    // Only the differences of the weights matter
+    double g_first {log_weights.front()};
+    for (double& g : log_weights) {
+      g -= g_first;
+    }
+
+    // Production stage with frozen weights
+    visits.assign(n_temperatures, 0);
+    e_sums.assign(n_temperatures, 0.0);
+    e2_sums.assign(n_temperatures, 0.0);
+    long production_sweeps {static_cast<long>(mc_parameters.Nt)
+                            * mc_parameters.mcs_av};
+    for (long sweep = 0; sweep < production_sweeps; sweep++) {
+      simulation_model.update_model_system(T_array[current]);
+      double e {simulation_model.get_model_energy()};
+      e_sums[current] += e;
+      e2_sums[current] += e * e;
+      visits[current]++;
+      if ((sweep + 1) % parameters.interval == 0) {
+        attempt_hop(simulation_model);
+      }
+    }
+
+    save_results();
+
+    std::cout << "Visits of the temperatures:";
+    for (long n_visits : visits) {
+      std::cout << ' ' << n_visits;
+    }
+    std::cout << '\n';
+
+    std::string save_loc {mc_parameters.final_structure_address
+                          + "final_structure.dat"};
+    simulation_model.save_model_state(save_loc);
+  }
+
+  void simulated_tempering::attempt_hop(model_space::model &simulation_model){
+    std::uniform_real_distribution<double> u_dist(0.0, 1.0);
+    bool up {u_dist(rng) < 0.5};
+    if (!(up and current + 1 == T_array.size()) and !(!up and current == 0)) {
+      std::size_t next {up ? current + 1 : current - 1};
+      // The weight at each temperature includes the chemical potentials of
+      // the insert_remove moves
+      double delta {(1.0 / T_array[next] - 1.0 / T_array[current])
+                        * simulation_model.get_model_grand_energy()
+                    - log_weights[next] + log_weights[current]};
+      if (delta <= 0 or std::exp(-delta) > u_dist(rng)) {
+        current = next;
+      }
+    }
+  }
+
+  bool simulated_tempering::is_histogram_flat(){
+    long n_min {*std::min_element(visits.begin(), visits.end())};
+    double mean {0.0};
+    for (long n_visits : visits) {
+      mean += static_cast<double>(n_visits);
+    }
+    mean /= static_cast<double>(visits.size());
+    return n_min > 0 and static_cast<double>(n_min) > parameters.flatness * mean;
+  }
+
+  void simulated_tempering::save_results(){
+    std::ofstream output_f;
+    output_f.open(parameters.output);
+    if (!output_f) {
+      std::cerr << "Could not open " << parameters.output << '\n';
+      exit(1);
+    }
+    output_f << "# T g visits <E> <E^2>\n";
+    for (std::size_t m = 0; m < T_array.size(); m++) {
+      double n_samples {static_cast<double>(std::max(visits[m], 1L))};
+      output_f << T_array[m] << ' ' << log_weights[m] << ' ' << visits[m]
+               << ' ' << e_sums[m] / n_samples << ' '
+               << e2_sums[m] / n_samples << '\n';
+    }
+  }
+}
@@ -0,0 +1,201 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "umbrella_sampling.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace simulation_space{
+
+  umbrella_parameters_struct::umbrella_parameters_struct(
+      std::string& mc_input, const mc_parameters_struct& mc_parameters){
+    /*
+     * Populate the struct using the input JSON file
+     */
+
+    std::ifstream mc_f;
+    mc_f.open(mc_input);
+    if(!mc_f){
+      std::cerr << "Could not open JSON MC parameters file" << std::endl;
+      exit(1);
+    }
+
+    json json_mc_params = json::parse(mc_f);
+
+    if (json_mc_params.contains("umbrella_centers")) {
+      centers = json_mc_params["umbrella_centers"].template get<vec1d>();
+    }
+    else if (json_mc_params.contains("umbrella_n_windows")) {
+      int n_windows {json_mc_params["umbrella_n_windows"].template get<int>()};
+      double first {json_mc_params["umbrella_min"].template get<double>()};
+      double last {json_mc_params["umbrella_max"].template get<double>()};
+      for (int k = 0; k < n_windows; k++) {
+        double x {n_windows > 1 ? static_cast<double>(k) / (n_windows - 1)
+                                : 0.0};
+        centers.push_back(first + x * (last - first));
+      }
+    }
+    if (centers.empty()) {
+      std::cerr << "Umbrella sampling needs umbrella_centers, or "
+                   "umbrella_n_windows, umbrella_min and umbrella_max\n";
+      exit(1);
+    }
+    if (json_mc_params.contains("umbrella_spring")) {
+      spring = json_mc_params["umbrella_spring"].template get<double>();
+    }
+    if (json_mc_params.contains("umbrella_window_width")) {
+      window_width =
+          json_mc_params["umbrella_window_width"].template get<int>();
+    }
+    output = mc_parameters.final_structure_address + "umbrella_";
+    if (json_mc_params.contains("umbrella_output")) {
+      output = json_mc_params["umbrella_output"].template get<std::string>();
+    }
+  }
+
+  umbrella_sampling::umbrella_sampling(
+      std::string& mc_input,
+      const mc_parameters_struct& mc_params,
+      const vec1d& temperatures)
+      : parameters {umbrella_parameters_struct(mc_input, mc_params)}
+      , mc_parameters {mc_params}
+      , T_array {temperatures}
+      , pool {mc_params.n_threads}
+  {
+  }
+
+  void umbrella_sampling::run(model_space::model &simulation_model){
+
+    std::size_t n_windows {parameters.centers.size()};
+
+    // Every window starts from the input configuration with its own seed
+    std::random_device dev;
+    windows.clear();
+    for (std::size_t k = 0; k < n_windows; k++) {
+      double center {parameters.centers[k]};
+      int window_min {0};
+      int window_max {std::numeric_limits<int>::max()};
+      if (parameters.window_width > 0) {
+        window_min = static_cast<int>(std::ceil(center))
+                     - parameters.window_width;
+        window_max = static_cast<int>(std::floor(center))
+                     + parameters.window_width;
+      }
+      windows.push_back(simulation_model);
+      windows.back().reseed_model_rng(dev());
+      windows.back().set_model_umbrella(
+          center, parameters.spring, window_min, window_max);
+    }
+
+    std::cout << "Umbrella sampling of the largest cluster size in "
+              << n_windows << " windows on " << pool.get_n_threads()
+              << " threads\n";
+
+    for (std::size_t i = 0; i < T_array.size(); i++) {
+
+      double T {T_array[i]};
+      // insert_remove moves can grow the largest cluster past the initial
+      // number of particles, so the histograms grow with the sizes met
+      // rather than covering every site of a possibly huge sparse lattice
+      histograms.assign(n_windows, {});
+
+      pool.parallel_for(static_cast<int>(n_windows), [&](int w){
+        std::size_t u_w {static_cast<std::size_t>(w)};
+        model_space::model& window {windows[u_w]};
+        for (int step = 0; step < mc_parameters.mcs_eq; step++) {
+          window.update_model_system(T);
+        }
+        for (int step = 0; step < mc_parameters.mcs_av; step++) {
+          window.update_model_system(T);
+          std::size_t n {
+              static_cast<std::size_t>(window.get_model_largest_cluster())};
+          if (n >= histograms[u_w].size()) {
+            histograms[u_w].resize(n + 1, 0);
+          }
+          histograms[u_w][n]++;
+        }
+      });
+
+      save_histograms(T);
+
+      std::cout << "Mean largest cluster size at T = " << T << ":";
+      for (std::size_t k = 0; k < n_windows; k++) {
+        double n_av {0.0};
+        double n_samples {0.0};
+        for (std::size_t n = 0; n < histograms[k].size(); n++) {
+          double count {static_cast<double>(histograms[k][n])};
+          n_av += static_cast<double>(n) * count;
+          n_samples += count;
+        }
+        std::cout << ' ' << (n_samples > 0 ? n_av / n_samples : 0.0);
+      }
+      std::cout << '\n';
+
+      if (mc_parameters.checkpoint_option) {
+        for (std::size_t k = 0; k < n_windows; k++) {
+          std::string save_loc {mc_parameters.checkpoint_address
+                                + "structure_" + std::to_string(i)
+                                + "_umbrella_" + std::to_string(k) + ".dat"};
+          windows[k].save_model_state(save_loc);
+        }
+      }
+    }
+
+    for (std::size_t k = 0; k < n_windows; k++) {
+      std::string save_loc {mc_parameters.final_structure_address
+                            + "final_structure_umbrella_"
+                            + std::to_string(k) + ".dat"};
+      windows[k].save_model_state(save_loc);
+    }
+  }
+
+  void umbrella_sampling::save_histograms(double T){
+    std::string prefix {parameters.output + "T_" + std::to_string(T)};
+
+    std::ofstream metadata_f;
+    metadata_f.open(prefix + "_metadata.dat");
+    if (!metadata_f) {
+      std::cerr << "Could not open " << prefix << "_metadata.dat\n";
+      exit(1);
+    }
+    metadata_f << "# histogram_file center spring window_min window_max\n";
+
+    // All the histograms cover the sizes from 0 to the largest one met
+    std::size_t n_bins {0};
+    for (const std::vector<long>& histogram : histograms) {
+      n_bins = std::max(n_bins, histogram.size());
+    }
+
+    for (std::size_t k = 0; k < histograms.size(); k++) {
+      std::string histogram_output {prefix + "_window_" + std::to_string(k)
+                                    + ".dat"};
+      std::ofstream histogram_f;
+      histogram_f.open(histogram_output);
+      if (!histogram_f) {
+        std::cerr << "Could not open " << histogram_output << '\n';
+        exit(1);
+      }
+      histograms[k].resize(n_bins, 0);
+      histogram_f << "# n count\n";
+      for (std::size_t n = 0; n < histograms[k].size(); n++) {
+        histogram_f << n << ' ' << histograms[k][n] << '\n';
+      }
+
+      double center {parameters.centers[k]};
+      int window_min {0};
+      int window_max {static_cast<int>(histograms[k].size()) - 1};
+      if (parameters.window_width > 0) {
+        window_min = std::max(window_min, static_cast<int>(std::ceil(center))
+                                              - parameters.window_width);
+        window_max = std::min(window_max, static_cast<int>(std::floor(center))
+                                              + parameters.window_width);
+      }
+      metadata_f << histogram_output << ' ' << center << ' '
+                 << parameters.spring << ' ' << window_min << ' '
+                 << window_max << '\n';
+    }
+  }
+}
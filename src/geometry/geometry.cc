@@ -5,6 +5,9 @@
 #include "chain.h"
 #include "fcc.h"
 #include "vector_utils.h"
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
 #include <stdexcept>
 #include <string>
 
@@ -20,6 +23,7 @@ bond_struct::bond_struct(lattice_options lattice)
       bond_permutation = chain_space::bond_struct::bond_permutation;
       bond_array = chain_space::bond_struct::bond_array;
       bond_index = chain_space::bond_struct::bond_index;
+      opposite_bonds = chain_space::bond_struct::opposite_bonds;
       break;
     case square:
       bond_permutation = square_space::bond_struct::bond_permutation;
@@ -78,6 +82,37 @@ lattice_options get_lattice_from_str(std::string& lattice_str)
                          "chain, square, triangular, cubic, bcc, fcc"));
 }
 
+site_ordering_options get_site_ordering_from_str(std::string& ordering_str)
+{
+  for (std::size_t i {0}; i < site_ordering_options::n_site_orderings; ++i) {
+    if (ordering_str == site_ordering_str_arr[i]) {
+      return static_cast<site_ordering_options>(i);
+    }
+  }
+  throw(std::runtime_error(
+      "Invalid site ordering provided.\nOptions are: row_major, morton"));
+}
+
+// Spread the lowest 21 bits of x so that two zero bits separate them
+static uint64_t spread_bits(uint64_t x)
+{
+  x &= 0x1fffff;
+  x = (x | x << 32) & 0x1f00000000ffff;
+  x = (x | x << 16) & 0x1f0000ff0000ff;
+  x = (x | x << 8) & 0x100f00f00f00f00f;
+  x = (x | x << 4) & 0x10c30c30c30c30c3;
+  x = (x | x << 2) & 0x1249249249249249;
+  return x;
+}
+
+// Morton code of the lattice coordinates (i, j, k): their bits interleaved
+static uint64_t get_morton_code(int i, int j, int k)
+{
+  return spread_bits(static_cast<uint64_t>(i))
+         | spread_bits(static_cast<uint64_t>(j)) << 1
+         | spread_bits(static_cast<uint64_t>(k)) << 2;
+}
+
 Geometry::Geometry(lattice_options lattice, int lx, int ly, int lz)
     : lattice_m {lattice}
     , lx_m {lx}
@@ -87,6 +122,7 @@ Geometry::Geometry(lattice_options lattice, int lx, int ly, int lz)
     , bond_struct_m {bond_struct(lattice)}
 {
   set_lattice_properties();
+  set_neighbour_table();
 }
 
 Geometry::Geometry(const std::string& geometry_input)
@@ -108,25 +144,58 @@ Geometry::Geometry(const std::string& geometry_input)
   n_sites_m = lx_m * ly_m * lz_m;
   bond_struct_m = bond_struct(lattice_m);
   set_lattice_properties();
+  if (json_geometry.contains("site_ordering")) {
+    std::string ordering_str {
+        json_geometry["site_ordering"].template get<std::string>()};
+    site_ordering_m = get_site_ordering_from_str(ordering_str);
+  }
+  if (json_geometry.contains("sparse_option")) {
+    sparse_m = json_geometry["sparse_option"].template get<bool>();
+  }
+  if (sparse_m and site_ordering_m != site_ordering_options::row_major) {
+    std::cerr << "A sparse geometry stores the sites in row-major order\n";
+    exit(1);
+  }
+  // Bonds must lead to distinct neighbours, so that a bond is known from the
+  // pair of sites it links
+  const std::array<int, 3> sides {lx_m, ly_m, lz_m};
+  for (const vec1i& bond_direction : bond_struct_m.bond_array) {
+    for (std::size_t axis {0}; sparse_m and axis < 3; axis++) {
+      if (bond_direction[axis] != 0 and sides[axis] < 3) {
+        std::cerr << "A sparse geometry needs at least 3 sites along every "
+                     "bond direction\n";
+        exit(1);
+      }
+    }
+  }
+  set_site_ordering();
+  if (!sparse_m) {
+    set_neighbour_table();
+  }
 }
 
-int Geometry::get_neighbour(const int site_ind, const int bond_ind) const
+int Geometry::compute_neighbour(const int site_ind, const int bond_ind) const
 {
   // Found at https://stackoverflow.com/a/26282004
   int i {};
   int j {};
   int k {};
-  array_space::r_to_ijk(site_ind, i, j, k, lx_m, ly_m, lz_m);
+  array_space::r_to_ijk(
+      get_row_major_index(site_ind), i, j, k, lx_m, ly_m, lz_m);
 
   std::size_t u_bond_ind {static_cast<std::size_t>(bond_ind)};
   const vec1i& bond_direction {bond_struct_m.bond_array[u_bond_ind]};
-  int i_neigh {array_space::mod(i + bond_direction[0], lx_m)};
-  int j_neigh {array_space::mod(j + bond_direction[1], ly_m)};
-  int k_neigh {array_space::mod(k + bond_direction[2], lz_m)};
+  // Periodic boundaries: the modulo is only needed at the edges
+  int i_neigh {i + bond_direction[0]};
+  int j_neigh {j + bond_direction[1]};
+  int k_neigh {k + bond_direction[2]};
+  if (i_neigh < 0 or i_neigh >= lx_m) i_neigh = array_space::mod(i_neigh, lx_m);
+  if (j_neigh < 0 or j_neigh >= ly_m) j_neigh = array_space::mod(j_neigh, ly_m);
+  if (k_neigh < 0 or k_neigh >= lz_m) k_neigh = array_space::mod(k_neigh, lz_m);
 
   int neigh_ind {0};
   array_space::ijk_to_r(neigh_ind, i_neigh, j_neigh, k_neigh, lx_m, ly_m, lz_m);
-  return neigh_ind;
+  return get_site_index(neigh_ind);
 }
 
 int Geometry::get_bond(const int site_1_ind, const int site_2_ind) const {
@@ -245,6 +314,8 @@ std::ostream &operator<<(std::ostream &out, Geometry &geometry) {
   out << "Lattice dimensions:" << '(' << geometry.lx_m << ", " << geometry.ly_m
       << ", " << geometry.lz_m << ")\n";
   out << "Number of sites: " << geometry.n_sites_m << '\n';
+  out << "Site ordering: "
+      << site_ordering_str_arr[geometry.site_ordering_m] << '\n';
   out << "Number of neighbours per site: " << geometry.n_neighbours_m << '\n';
   out << "Number of possible particle orientations:"
       << geometry.n_orientations_m << '\n';
@@ -281,4 +352,51 @@ void Geometry::set_lattice_properties()
   }
 }
 
+void Geometry::set_site_ordering()
+{
+  row_major_of_site_m.clear();
+  site_of_row_major_m.clear();
+  if (site_ordering_m == site_ordering_options::row_major) return;
+
+  // Sites are sorted by the Morton code of their coordinates. Sorting, rather
+  // than using the code as an index, handles lattice sides which are not
+  // powers of 2
+  std::size_t n_sites {static_cast<std::size_t>(n_sites_m)};
+  std::vector<uint64_t> codes(n_sites);
+  for (int r {0}; r < n_sites_m; r++) {
+    int i {};
+    int j {};
+    int k {};
+    array_space::r_to_ijk(r, i, j, k, lx_m, ly_m, lz_m);
+    codes[static_cast<std::size_t>(r)] = get_morton_code(i, j, k);
+  }
+  row_major_of_site_m = vec1i(n_sites);
+  std::iota(row_major_of_site_m.begin(), row_major_of_site_m.end(), 0);
+  std::sort(row_major_of_site_m.begin(),
+            row_major_of_site_m.end(),
+            [&codes](int r_1, int r_2) {
+              return codes[static_cast<std::size_t>(r_1)]
+                     < codes[static_cast<std::size_t>(r_2)];
+            });
+  site_of_row_major_m = vec1i(n_sites);
+  for (int site {0}; site < n_sites_m; site++) {
+    std::size_t u_site {static_cast<std::size_t>(site)};
+    std::size_t r {static_cast<std::size_t>(row_major_of_site_m[u_site])};
+    site_of_row_major_m[r] = site;
+  }
+}
+
+void Geometry::set_neighbour_table()
+{
+  std::size_t n_entries {static_cast<std::size_t>(n_sites_m * n_neighbours_m)};
+  neighbour_table_m = vec1i(n_entries);
+  std::size_t entry {0};
+  for (int site {0}; site < n_sites_m; site++) {
+    for (int bond {0}; bond < n_neighbours_m; bond++) {
+      neighbour_table_m[entry] = compute_neighbour(site, bond);
+      ++entry;
+    }
+  }
+}
+
 } // namespace geometry_space
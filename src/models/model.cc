@@ -19,6 +19,7 @@ model::model(std::string& model_params_file)
     , interactions {particles_space::interactions_struct {}}
     , averages {particles_space::averages_struct {}}
     , records {particles_space::records_struct {}}
+    , lockstep {particles_space::lockstep_struct {}}
 {
   /*
    * Initialize the system of particles and calculate the initial energy
@@ -29,6 +30,8 @@ model::model(std::string& model_params_file)
 
   particles_space::initialize_interactions(
       state, interactions, parameters, geometry);
+
+  particles_space::initialize_best_state(state, interactions, records);
 }
 
 void model::print_model_state()
@@ -53,7 +56,8 @@ void model::print_model_energy()
 
 void model::update_model_system(double T)
 {
-  particles_space::update_system(state, interactions, parameters, geometry, T);
+  particles_space::update_system(
+      state, interactions, parameters, geometry, records, T);
 }
 
 void model::initialize_model_averages()
@@ -81,4 +85,242 @@ void model::save_model_records(double T)
   save_records(parameters, T, records);
 }
 
+double model::get_model_energy()
+{
+  return interactions.energy;
+}
+
+double model::get_model_grand_energy()
+{
+  double grand_energy {interactions.energy};
+  for (int type {0}; type < state.n_types; type++) {
+    grand_energy -= particles_space::get_chemical_potential(parameters, type)
+        * state.n_particles[static_cast<std::size_t>(type)];
+  }
+  return grand_energy;
+}
+
+void model::reseed_model_rng(unsigned int seed)
+{
+  parameters.rng.seed(seed);
+  // Positions drawn ahead with the previous generator would be shared with
+  // the replica this one was copied from
+  state.full_empty_sites.clear_full_sites_ahead();
+}
+
+void model::copy_model_state(const model& other)
+{
+  state = other.state;
+  // The positions drawn ahead by other must not be replayed by this copy
+  state.full_empty_sites.clear_full_sites_ahead();
+  if (interactions.couplings == other.interactions.couplings) {
+    interactions.energy = other.interactions.energy;
+  } else {
+    interactions.energy =
+        particles_space::get_energy(state, interactions, geometry);
+  }
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+}
+
+void model::load_model_state(const std::string& state_input)
+{
+  particles_space::load_state(state, state_input);
+  interactions.energy =
+      particles_space::get_energy(state, interactions, geometry);
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_best_state(state, interactions, records);
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+}
+
+particles_space::SiteVector model::get_model_configuration()
+{
+  return state.lattice_sites;
+}
+
+void model::set_model_configuration(const particles_space::SiteVector& sites)
+{
+  particles_space::reset_state_sites(state, sites);
+  interactions.energy =
+      particles_space::get_energy(state, interactions, geometry);
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+}
+
+int model::get_model_n_particles()
+{
+  return state.full_empty_sites.get_n_full_sites();
+}
+
+int model::get_model_n_sites()
+{
+  return state.n_sites;
+}
+
+vec1i model::get_model_particle_numbers()
+{
+  return state.n_particles;
+}
+
+vec1d model::get_model_chemical_potentials()
+{
+  return parameters.chemical_potentials;
+}
+
+void model::set_model_chemical_potentials(const vec1d& chemical_potentials)
+{
+  parameters.chemical_potentials = chemical_potentials;
+}
+
+bool model::is_grand_canonical()
+{
+  return parameters.move_probas[particles_space::mc_moves::insert_remove] > 0;
+}
+
+int model::get_model_largest_cluster()
+{
+  // Under an umbrella bias the clusters are tracked through the moves
+  if (parameters.umbrella.option) {
+    return parameters.umbrella.current_size;
+  }
+  return particles_space::get_largest_cluster_size(state, geometry);
+}
+
+void model::set_model_umbrella(double center,
+                               double spring,
+                               int window_min,
+                               int window_max)
+{
+  particles_space::umbrella_struct& umbrella {parameters.umbrella};
+  umbrella.option = true;
+  umbrella.center = center;
+  umbrella.spring = spring;
+  umbrella.window_min = window_min;
+  umbrella.window_max = window_max;
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+}
+
+void model::set_model_demon(bool option, double energy)
+{
+  using particles_space::mc_moves;
+  if (option
+      and (parameters.move_probas[mc_moves::heat_bath_rotate] > 0
+           or parameters.move_probas[mc_moves::heat_bath_mutate] > 0
+           or parameters.move_probas[mc_moves::insert_remove] > 0
+           or parameters.site_energy_bias != 0.0))
+  {
+    std::cerr << "The Creutz demon only handles Metropolis moves with "
+                 "uniform picks\n";
+    exit(1);
+  }
+  parameters.demon.option = option;
+  parameters.demon.energy = energy;
+}
+
+double model::get_model_demon_energy()
+{
+  return parameters.demon.energy;
+}
+
+long model::get_model_n_accepted_moves()
+{
+  return parameters.n_accepted_moves;
+}
+
+vec2d model::get_model_replica_couplings()
+{
+  return parameters.replica_couplings;
+}
+
+double model::get_model_energy(const vec1d& other_couplings)
+{
+  // Only the couplings are needed, not the scratch spaces and the cache
+  particles_space::interactions_struct other_interactions {};
+  other_interactions.couplings = other_couplings;
+  return particles_space::get_energy(state, other_interactions, geometry);
+}
+
+void model::set_model_couplings(const vec1d& new_couplings)
+{
+  interactions.couplings = new_couplings;
+  particles_space::clear_delta_e_cache(interactions);
+  interactions.energy =
+      particles_space::get_energy(state, interactions, geometry);
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_best_state(state, interactions, records);
+}
+
+void model::set_model_couplings(const vec1d& new_couplings, double new_energy)
+{
+  interactions.couplings = new_couplings;
+  particles_space::clear_delta_e_cache(interactions);
+  interactions.energy = new_energy;
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_best_state(state, interactions, records);
+}
+
+void model::print_model_cache_statistics()
+{
+  particles_space::print_delta_e_cache_statistics(interactions);
+}
+
+bool model::is_best_state_tracked()
+{
+  return parameters.best_state_option;
+}
+
+double model::get_model_best_energy()
+{
+  return records.best_energy;
+}
+
+void model::save_model_best_state(std::string& state_output)
+{
+  particles_space::save_best_state(state, records, state_output);
+}
+
+void model::restore_model_best_state()
+{
+  particles_space::restore_best_state(state, interactions, records);
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+}
+
+long model::quench_model()
+{
+  long n_moves {particles_space::quench_system(
+      state, interactions, parameters, geometry)};
+  particles_space::initialize_site_energy_field(state, interactions, geometry);
+  particles_space::initialize_umbrella_clusters(state, parameters, geometry);
+  particles_space::update_best_state(parameters, state, interactions, records);
+  return n_moves;
+}
+
+vec2d model::get_model_exact_thermodynamics(const vec1d& temperatures)
+{
+  return particles_space::get_exact_thermodynamics(
+      state, interactions, parameters, geometry, temperatures);
+}
+
+void model::initialize_model_lockstep(int n_lanes)
+{
+  particles_space::initialize_lockstep(
+      lockstep, n_lanes, state, interactions, parameters, geometry);
+}
+
+void model::update_model_lockstep(double T)
+{
+  particles_space::update_lockstep(lockstep, geometry, T);
+}
+
+vec1d model::get_model_lockstep_energies()
+{
+  return lockstep.energies;
+}
+
+void model::save_model_lockstep_state(int lane, std::string& state_output)
+{
+  particles_space::save_lockstep_state(lockstep, lane, state_output);
+}
+
 }  // namespace model_space
@@ -1,4 +1,5 @@
 #include "particles_interactions.h"
+#include <algorithm>
 #include <array>
 #include <iomanip>
 #include <typeinfo>
@@ -12,6 +13,13 @@ void initialize_interactions(state_struct& state,
 {
   interactions.couplings = parameters.couplings;
   interactions.energy = get_energy(state, interactions, geometry);
+  initialize_delta_e_cache(
+      state, interactions, geometry, parameters.delta_e_cache_size);
+  if (parameters.site_energy_bias != 0.0) {
+    interactions.site_energy_field.option = true;
+    interactions.site_energy_field.bias = parameters.site_energy_bias;
+    initialize_site_energy_field(state, interactions, geometry);
+  }
 }
 
 double get_contact_energy(state_struct& state,
@@ -42,6 +50,27 @@ double get_contact_energy(state_struct& state,
                                   interactions.couplings);
 }
 
+double get_contact_energy(state_struct& state,
+                          int site1,
+                          int site2,
+                          int bond,
+                          interactions_struct& interactions,
+                          geometry_space::Geometry& geometry)
+{
+  if (state.lattice_sites.is_empty(site1)
+      or state.lattice_sites.is_empty(site2))
+  {
+    return 0.0;
+  }
+  return geometry.get_interaction(state.lattice_sites.get_orientation(site1),
+                                  state.lattice_sites.get_type(site1),
+                                  state.lattice_sites.get_orientation(site2),
+                                  state.lattice_sites.get_type(site2),
+                                  bond,
+                                  state.n_types,
+                                  interactions.couplings);
+}
+
 double get_site_energy(state_struct& state,
                        interactions_struct& interactions,
                        geometry_space::Geometry& geometry,
@@ -55,6 +84,13 @@ double get_site_energy(state_struct& state,
     for (int bond {0}; bond < geometry.get_n_neighbours(); ++bond) {
       int neighbour_site {geometry.get_neighbour(site_index, bond)};
       /*std::cout << "Checking neighbour " << neighbour_site << '\n' ;*/
+      // Without a neighbour table, searching for the bond again would
+      // recompute every neighbour
+      if (geometry.is_sparse()) {
+        site_energy += get_contact_energy(
+            state, site_index, neighbour_site, bond, interactions, geometry);
+        continue;
+      }
       site_energy += get_contact_energy(
           state, site_index, neighbour_site, interactions, geometry);
     }
@@ -62,11 +98,248 @@ double get_site_energy(state_struct& state,
   return site_energy;
 }
 
+void get_site_state_energies(state_struct& state,
+                             interactions_struct& interactions,
+                             geometry_space::Geometry& geometry,
+                             int site_index,
+                             vec1d& state_energies)
+{
+  const std::size_t n_states {static_cast<std::size_t>(state.n_states)};
+  const std::size_t n_orientations {
+      static_cast<std::size_t>(state.n_orientations)};
+  const std::size_t n_types {static_cast<std::size_t>(state.n_types)};
+  state_energies.assign(n_states, 0.0);
+
+  for (int bond {0}; bond < geometry.get_n_neighbours(); ++bond) {
+    int neighbour_site {geometry.get_neighbour(site_index, bond)};
+    if (state.lattice_sites.is_empty(neighbour_site)) {
+      continue;
+    }
+    // The neighbour fixes a row of the interaction matrix, over which every
+    // state of the site is a gather through the bond permutation
+    std::size_t neighbour_coeff {static_cast<std::size_t>(
+        geometry.get_interaction_coeff(
+            state.lattice_sites.get_orientation(neighbour_site),
+            state.lattice_sites.get_type(neighbour_site),
+            geometry.get_opposite_bond(bond)))};
+    const double* couplings_row {
+        &interactions.couplings[n_states * neighbour_coeff]};
+    const vec1i& permutation {geometry.get_bond_permutation(bond)};
+    for (std::size_t type {0}; type < n_types; type++) {
+      double* type_energies {&state_energies[n_orientations * type]};
+      const double* type_couplings {&couplings_row[n_orientations * type]};
+      for (std::size_t orientation {0}; orientation < n_orientations;
+           orientation++) {
+        type_energies[orientation] += type_couplings[static_cast<std::size_t>(
+            permutation[orientation])];
+      }
+    }
+  }
+}
+
+double get_site_change_energy(state_struct& state,
+                              interactions_struct& interactions,
+                              geometry_space::Geometry& geometry,
+                              int site_index,
+                              int old_orientation,
+                              int old_type)
+{
+  delta_e_cache_struct& cache {interactions.delta_e_cache};
+  std::uint64_t key {0};
+  std::size_t slot {0};
+  if (cache.option) {
+    // Site states are encoded as 0 for an empty site, 1 + state otherwise
+    const std::uint64_t base {static_cast<std::uint64_t>(state.n_states) + 1};
+    key = static_cast<std::uint64_t>(
+        1 + old_orientation + state.n_orientations * old_type);
+    key = key * base
+        + static_cast<std::uint64_t>(
+              1 + state.lattice_sites.get_orientation(site_index)
+              + state.n_orientations * state.lattice_sites.get_type(site_index));
+    for (int bond {0}; bond < geometry.get_n_neighbours(); ++bond) {
+      int neighbour_site {geometry.get_neighbour(site_index, bond)};
+      key = key * base
+          + static_cast<std::uint64_t>(
+                state.lattice_sites.get_state(neighbour_site) + 1);
+    }
+    // Fibonacci hashing spreads the keys over the slots
+    slot = static_cast<std::size_t>((key * 0x9E3779B97F4A7C15ULL)
+                                    >> (64 - cache.index_bits));
+    cache.n_lookups++;
+    if (cache.keys[slot] == key) {
+      cache.n_hits++;
+      return cache.delta_e[slot];
+    }
+  }
+
+  int new_orientation {state.lattice_sites.get_orientation(site_index)};
+  int new_type {state.lattice_sites.get_type(site_index)};
+  double delta_e {get_site_energy(state, interactions, geometry, site_index)};
+  state.lattice_sites.set_site(site_index, old_type, old_orientation);
+  delta_e -= get_site_energy(state, interactions, geometry, site_index);
+  state.lattice_sites.set_site(site_index, new_type, new_orientation);
+
+  if (cache.option) {
+    cache.keys[slot] = key;
+    cache.delta_e[slot] = delta_e;
+  }
+  return delta_e;
+}
+
+void initialize_delta_e_cache(state_struct& state,
+                              interactions_struct& interactions,
+                              geometry_space::Geometry& geometry,
+                              int n_slots)
+{
+  delta_e_cache_struct& cache {interactions.delta_e_cache};
+  cache = delta_e_cache_struct {};
+  if (n_slots <= 0) {
+    return;
+  }
+  double key_bits {(geometry.get_n_neighbours() + 2)
+                   * std::log2(state.n_states + 1.0)};
+  if (key_bits >= 63) {
+    std::cerr << "Warning: the energy change cache is disabled, as its keys "
+                 "would need "
+              << key_bits << " bits\n";
+    return;
+  }
+  cache.option = true;
+  while ((1 << cache.index_bits) < n_slots and cache.index_bits < 30) {
+    cache.index_bits++;
+  }
+  cache.index_bits = std::max(cache.index_bits, 1);
+  std::size_t size {std::size_t {1} << cache.index_bits};
+  clear_delta_e_cache(interactions);
+  cache.delta_e.assign(size, 0.0);
+}
+
+void clear_delta_e_cache(interactions_struct& interactions)
+{
+  delta_e_cache_struct& cache {interactions.delta_e_cache};
+  if (cache.option) {
+    // No key reaches the largest 64-bit integer, which thus marks empty slots
+    cache.keys.assign(std::size_t {1} << cache.index_bits, UINT64_MAX);
+  }
+}
+
+void print_delta_e_cache_statistics(interactions_struct& interactions)
+{
+  delta_e_cache_struct& cache {interactions.delta_e_cache};
+  if (!cache.option) {
+    return;
+  }
+  double hit_rate {cache.n_lookups > 0
+                       ? static_cast<double>(cache.n_hits)
+                           / static_cast<double>(cache.n_lookups)
+                       : 0.0};
+  std::size_t memory {cache.keys.size()
+                      * (sizeof(std::uint64_t) + sizeof(double))};
+  std::cout << "Energy change cache: " << cache.n_hits << " hits out of "
+            << cache.n_lookups << " lookups (hit rate " << hit_rate << "), "
+            << cache.keys.size() << " slots using " << memory << " bytes\n";
+}
+
+void initialize_site_energy_field(state_struct& state,
+                                  interactions_struct& interactions,
+                                  geometry_space::Geometry& geometry)
+{
+  site_energy_field_struct& field {interactions.site_energy_field};
+  if (!field.option) {
+    return;
+  }
+  const std::size_t n_sites {static_cast<std::size_t>(state.n_sites)};
+  field.energies.resize(n_sites);
+  vec1d weights(n_sites);
+  for (int i {0}; i < state.n_sites; i++) {
+    std::size_t u_i {static_cast<std::size_t>(i)};
+    field.energies[u_i] = get_site_energy(state, interactions, geometry, i);
+    weights[u_i] = get_site_weight(state, field, i, field.energies[u_i]);
+  }
+  field.weights.assign(weights);
+}
+
+double get_site_weight(state_struct& state,
+                       const site_energy_field_struct& field,
+                       int site_index,
+                       double site_energy)
+{
+  if (state.lattice_sites.is_empty(site_index)) {
+    return 0.0;
+  }
+  return std::exp(field.bias * site_energy);
+}
+
+void get_changed_site_energies(state_struct& state,
+                               interactions_struct& interactions,
+                               geometry_space::Geometry& geometry,
+                               int site_1,
+                               int site_2)
+{
+  site_energy_field_struct& field {interactions.site_energy_field};
+  field.changed_sites.clear();
+  field.changed_energies.clear();
+  auto add_site {[&](int site) {
+    // Small lattices can list the same neighbour twice
+    if (std::find(field.changed_sites.begin(), field.changed_sites.end(), site)
+        == field.changed_sites.end())
+    {
+      field.changed_sites.push_back(site);
+      field.changed_energies.push_back(
+          get_site_energy(state, interactions, geometry, site));
+    }
+  }};
+  for (int site : {site_1, site_2}) {
+    if (site < 0) {
+      continue;
+    }
+    add_site(site);
+    for (int bond {0}; bond < geometry.get_n_neighbours(); ++bond) {
+      add_site(geometry.get_neighbour(site, bond));
+    }
+  }
+}
+
+void commit_site_energies(state_struct& state,
+                          interactions_struct& interactions)
+{
+  site_energy_field_struct& field {interactions.site_energy_field};
+  for (std::size_t k {0}; k < field.changed_sites.size(); k++) {
+    int site {field.changed_sites[k]};
+    std::size_t u_site {static_cast<std::size_t>(site)};
+    field.energies[u_site] = field.changed_energies[k];
+    field.weights.set_weight(
+        u_site, get_site_weight(state, field, site, field.energies[u_site]));
+  }
+}
+
+void update_site_energies(state_struct& state,
+                          interactions_struct& interactions,
+                          geometry_space::Geometry& geometry,
+                          int site_1,
+                          int site_2)
+{
+  if (interactions.site_energy_field.option) {
+    get_changed_site_energies(state, interactions, geometry, site_1, site_2);
+    commit_site_energies(state, interactions);
+  }
+}
+
 double get_energy(state_struct& state,
                   interactions_struct& interactions,
                   geometry_space::Geometry& geometry)
 {
   double energy {0.0};
+  if (state.lattice_sites.is_sparse()) {
+    // Only the full sites contribute
+    const std::size_t n_full_sites {
+        static_cast<std::size_t>(state.full_empty_sites.get_n_full_sites())};
+    for (std::size_t k {0}; k < n_full_sites; k++) {
+      int site {state.full_empty_sites.get_full_site(k)};
+      energy += get_site_energy(state, interactions, geometry, site);
+    }
+    return energy / 2;
+  }
   for (int i {0}; i < state.n_sites; i++)
     energy += get_site_energy(state, interactions, geometry, i);
   // Divide by 2, otherwise we'll be double counting!
@@ -0,0 +1,285 @@
+#include "particles_lockstep.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+
+namespace particles_space {
+
+void initialize_lockstep(lockstep_struct& lockstep,
+                         int n_lanes,
+                         state_struct& state,
+                         interactions_struct& interactions,
+                         model_parameters_struct& parameters,
+                         geometry_space::Geometry& geometry)
+{
+  if (n_lanes <= 0) {
+    n_lanes = static_cast<int>(parameters.replica_couplings.size());
+  }
+  if (n_lanes <= 0) {
+    throw std::runtime_error("Lockstep update needs at least one lane");
+  }
+  if (!parameters.replica_couplings.empty()
+      and static_cast<int>(parameters.replica_couplings.size()) != n_lanes)
+  {
+    throw std::runtime_error(
+        "replica_couplings must contain one coupling matrix per lane");
+  }
+  if (state.lattice_sites.is_sparse()) {
+    throw std::runtime_error("Lockstep update needs a dense state");
+  }
+
+  std::size_t u_lanes {static_cast<std::size_t>(n_lanes)};
+  lockstep.n_lanes = n_lanes;
+  lockstep.n_sites = state.n_sites;
+  lockstep.site_of_row_major = state.site_of_row_major;
+  lockstep.n_neighbours = state.n_neighbours;
+  lockstep.n_orientations = state.n_orientations;
+  lockstep.n_types = state.n_types;
+  lockstep.n_states = state.n_states;
+
+  // Split the move probability between rotations and mutations. Mutations are
+  // impossible with a single particle type.
+  double p_rotate {parameters.move_probas[mc_moves::rotate]};
+  double p_mutate {parameters.move_probas[mc_moves::mutate]};
+  if (state.n_types < 2) {
+    p_mutate = 0.0;
+  }
+  if (p_rotate + p_mutate <= 0.0) {
+    throw std::runtime_error(
+        "Lockstep update needs non-zero rotate or mutate probabilities");
+  }
+  lockstep.rotate_proba = p_rotate / (p_rotate + p_mutate);
+
+  // Interleave the current state of the system in every lane
+  std::size_t n_entries {static_cast<std::size_t>(state.n_sites) * u_lanes};
+  lockstep.types = vec1i(n_entries);
+  lockstep.orientations = vec1i(n_entries);
+  lockstep.occupied = vec1i(static_cast<std::size_t>(state.n_sites), 0);
+  lockstep.full_sites.clear();
+  for (int site {0}; site < state.n_sites; site++) {
+    std::size_t u_site {static_cast<std::size_t>(site)};
+    for (std::size_t lane {0}; lane < u_lanes; lane++) {
+      lockstep.types[u_site * u_lanes + lane] =
+          state.lattice_sites.get_type(site);
+      lockstep.orientations[u_site * u_lanes + lane] =
+          state.lattice_sites.get_orientation(site);
+    }
+    if (!state.lattice_sites.is_empty(site)) {
+      lockstep.occupied[u_site] = 1;
+      lockstep.full_sites.push_back(site);
+    }
+  }
+
+  // Tabulate the faces presented through each bond
+  lockstep.bond_faces.clear();
+  lockstep.opposite_bonds.clear();
+  for (int bond {0}; bond < state.n_neighbours; bond++) {
+    for (int orientation {0}; orientation < state.n_orientations;
+         orientation++) {
+      lockstep.bond_faces.push_back(
+          geometry.get_interaction_coeff(orientation, 0, bond));
+    }
+    lockstep.opposite_bonds.push_back(geometry.get_opposite_bond(bond));
+  }
+
+  lockstep.couplings.clear();
+  for (std::size_t lane {0}; lane < u_lanes; lane++) {
+    const vec1d& lane_couplings {parameters.replica_couplings.empty()
+                                     ? interactions.couplings
+                                     : parameters.replica_couplings[lane]};
+    if (static_cast<int>(lane_couplings.size())
+        != state.n_states * state.n_states)
+    {
+      throw std::runtime_error("Wrong size of the couplings of a lane");
+    }
+    lockstep.couplings.insert(
+        lockstep.couplings.end(), lane_couplings.begin(), lane_couplings.end());
+  }
+
+  lockstep.shared_rng.seed(static_cast<unsigned int>(parameters.rng()));
+  lockstep.lane_rngs.clear();
+  lockstep.energies.clear();
+  for (int lane {0}; lane < n_lanes; lane++) {
+    lockstep.lane_rngs.emplace_back(
+        static_cast<unsigned int>(parameters.rng()));
+    lockstep.energies.push_back(get_lockstep_energy(lockstep, geometry, lane));
+  }
+}
+
+void update_lockstep(lockstep_struct& lockstep,
+                     geometry_space::Geometry& geometry,
+                     double T)
+{
+  if (lockstep.full_sites.empty()) {
+    return;
+  }
+  const vec1i& neighbours {geometry.get_neighbour_table()};
+  const std::size_t n_lanes {static_cast<std::size_t>(lockstep.n_lanes)};
+  const std::size_t n_neighbours {
+      static_cast<std::size_t>(lockstep.n_neighbours)};
+  const std::size_t n_orientations {
+      static_cast<std::size_t>(lockstep.n_orientations)};
+  const int n_states {lockstep.n_states};
+  const std::size_t n_couplings {
+      static_cast<std::size_t>(n_states * n_states)};
+
+  int_dist site_dist {0, static_cast<int>(lockstep.full_sites.size()) - 1};
+  real_dist move_dist {0.0, 1.0};
+  real_dist proba_dist {0.0, 1.0};
+  // Drawing among n - 1 values and skipping the current one gives a uniform
+  // choice among the other orientations or types
+  int_dist rot_dist {0, lockstep.n_orientations - 2};
+  int_dist type_dist {0, std::max(lockstep.n_types - 2, 0)};
+
+  // Per-lane scratch arrays
+  vec1i new_orientations(n_lanes);
+  vec1i new_types(n_lanes);
+  vec1d delta_e(n_lanes);
+
+  for (int attempt {0}; attempt < lockstep.n_sites; attempt++) {
+    // Site and move type are shared by all the lanes
+    std::size_t site {static_cast<std::size_t>(
+        lockstep.full_sites[static_cast<std::size_t>(
+            site_dist(lockstep.shared_rng))])};
+    bool rotate {move_dist(lockstep.shared_rng) < lockstep.rotate_proba};
+    int* site_orientations {&lockstep.orientations[site * n_lanes]};
+    int* site_types {&lockstep.types[site * n_lanes]};
+
+    // Proposals, one per lane
+    for (std::size_t lane {0}; lane < n_lanes; lane++) {
+      EngineType& lane_rng {lockstep.lane_rngs[lane]};
+      new_orientations[lane] = site_orientations[lane];
+      new_types[lane] = site_types[lane];
+      if (rotate) {
+        int new_orientation {rot_dist(lane_rng)};
+        new_orientations[lane] = new_orientation
+            + static_cast<int>(new_orientation >= site_orientations[lane]);
+      } else {
+        int new_type {type_dist(lane_rng)};
+        new_types[lane] =
+            new_type + static_cast<int>(new_type >= site_types[lane]);
+      }
+      delta_e[lane] = 0.0;
+    }
+
+    // Energy differences: each neighbour index is fetched once for all lanes
+    for (std::size_t bond {0}; bond < n_neighbours; bond++) {
+      std::size_t neighbour {
+          static_cast<std::size_t>(neighbours[site * n_neighbours + bond])};
+      if (!lockstep.occupied[neighbour]) {
+        continue;
+      }
+      const int* faces {&lockstep.bond_faces[bond * n_orientations]};
+      const int* opposite_faces {&lockstep.bond_faces[static_cast<std::size_t>(
+                                      lockstep.opposite_bonds[bond])
+                                  * n_orientations]};
+      const int* neighbour_orientations {
+          &lockstep.orientations[neighbour * n_lanes]};
+      const int* neighbour_types {&lockstep.types[neighbour * n_lanes]};
+      for (std::size_t lane {0}; lane < n_lanes; lane++) {
+        const double* lane_couplings {&lockstep.couplings[lane * n_couplings]};
+        int neighbour_coeff {
+            opposite_faces[neighbour_orientations[lane]]
+            + lockstep.n_orientations * neighbour_types[lane]};
+        int old_coeff {faces[site_orientations[lane]]
+                       + lockstep.n_orientations * site_types[lane]};
+        int new_coeff {faces[new_orientations[lane]]
+                       + lockstep.n_orientations * new_types[lane]};
+        delta_e[lane] += lane_couplings[new_coeff + n_states * neighbour_coeff]
+            - lane_couplings[old_coeff + n_states * neighbour_coeff];
+      }
+    }
+
+    // Metropolis test in every lane, applied with a mask
+    for (std::size_t lane {0}; lane < n_lanes; lane++) {
+      double boltzmann_factor {std::exp(-delta_e[lane] / T)};
+      bool accepted {delta_e[lane] < 0
+                     or boltzmann_factor
+                         > proba_dist(lockstep.lane_rngs[lane])};
+      site_orientations[lane] =
+          accepted ? new_orientations[lane] : site_orientations[lane];
+      site_types[lane] = accepted ? new_types[lane] : site_types[lane];
+      lockstep.energies[lane] += accepted ? delta_e[lane] : 0.0;
+    }
+  }
+}
+
+double get_lockstep_energy(lockstep_struct& lockstep,
+                           geometry_space::Geometry& geometry,
+                           int lane)
+{
+  std::size_t n_lanes {static_cast<std::size_t>(lockstep.n_lanes)};
+  std::size_t u_lane {static_cast<std::size_t>(lane)};
+  std::size_t n_orientations {static_cast<std::size_t>(lockstep.n_orientations)};
+  const double* lane_couplings {&lockstep.couplings[u_lane
+      * static_cast<std::size_t>(lockstep.n_states * lockstep.n_states)]};
+
+  double energy {0.0};
+  for (int site : lockstep.full_sites) {
+    std::size_t u_site {static_cast<std::size_t>(site)};
+    for (int bond {0}; bond < lockstep.n_neighbours; bond++) {
+      std::size_t neighbour {
+          static_cast<std::size_t>(geometry.get_neighbour(site, bond))};
+      if (!lockstep.occupied[neighbour]) {
+        continue;
+      }
+      std::size_t u_bond {static_cast<std::size_t>(bond)};
+      std::size_t opposite_bond {
+          static_cast<std::size_t>(lockstep.opposite_bonds[u_bond])};
+      int site_coeff {
+          lockstep.bond_faces[u_bond * n_orientations
+                              + static_cast<std::size_t>(
+                                  lockstep.orientations[u_site * n_lanes
+                                                        + u_lane])]
+          + lockstep.n_orientations
+              * lockstep.types[u_site * n_lanes + u_lane]};
+      int neighbour_coeff {
+          lockstep.bond_faces[opposite_bond * n_orientations
+                              + static_cast<std::size_t>(
+                                  lockstep.orientations[neighbour * n_lanes
+                                                        + u_lane])]
+          + lockstep.n_orientations
+              * lockstep.types[neighbour * n_lanes + u_lane]};
+      energy += lane_couplings[site_coeff
+                               + lockstep.n_states * neighbour_coeff];
+    }
+  }
+  // Every contact was counted twice
+  return energy / 2;
+}
+
+void save_lockstep_state(lockstep_struct& lockstep,
+                         int lane,
+                         std::string& state_output)
+{
+  std::ofstream state_f;
+  state_f.open(state_output);
+  if (!state_f) {
+    std::cerr << "Could not open " + state_output << std::endl;
+    exit(1);
+  }
+  std::size_t n_lanes {static_cast<std::size_t>(lockstep.n_lanes)};
+  std::size_t u_lane {static_cast<std::size_t>(lane)};
+  std::size_t n_sites {static_cast<std::size_t>(lockstep.n_sites)};
+  // Same format as save_state: types on line 1, orientations on line 2,
+  // sites in row-major order
+  vec1s sites(n_sites);
+  for (std::size_t r {0}; r < n_sites; r++) {
+    sites[r] = lockstep.site_of_row_major.empty()
+        ? r
+        : static_cast<std::size_t>(lockstep.site_of_row_major[r]);
+  }
+  for (std::size_t i : sites) {
+    state_f << lockstep.types[i * n_lanes + u_lane] << ' ';
+  }
+  state_f << '\n';
+  for (std::size_t i : sites) {
+    state_f << lockstep.orientations[i * n_lanes + u_lane] << ' ';
+  }
+  state_f << '\n';
+  state_f.close();
+}
+
+}  // namespace particles_space
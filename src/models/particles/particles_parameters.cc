@@ -23,7 +23,7 @@ model_parameters_struct::model_parameters_struct(const std::string& input_file)
   rng = engine;
   initialize_option =
       json_model_params["initialize_option"].template get<std::string>();
-  if (initialize_option == "from_file") {
+  if (initialize_option == "from_file" or initialize_option == "warm_start") {
     state_input = json_model_params["state_input"].template get<std::string>();
   }
   move_probas = get_move_probas(input_file);
@@ -41,6 +41,55 @@ model_parameters_struct::model_parameters_struct(const std::string& input_file)
     e_record_output =
         json_model_params["e_record_output"].template get<std::string>();
   }
+  if (json_model_params.contains("replica_couplings")) {
+    replica_couplings =
+        json_model_params["replica_couplings"].template get<vec2d>();
+  }
+  if (json_model_params.contains("best_state_option")) {
+    best_state_option =
+        json_model_params["best_state_option"].template get<bool>();
+  }
+  if (json_model_params.contains("best_state_threshold")) {
+    best_state_threshold =
+        json_model_params["best_state_threshold"].template get<double>();
+  }
+  if (json_model_params.contains("chemical_potentials")) {
+    chemical_potentials =
+        json_model_params["chemical_potentials"].template get<vec1d>();
+  }
+  if (json_model_params.contains("swap_empty_full_tries")) {
+    swap_empty_full_tries =
+        json_model_params["swap_empty_full_tries"].template get<int>();
+  }
+  if (swap_empty_full_tries < 1) {
+    std::cerr << "swap_empty_full_tries must be positive\n";
+    exit(1);
+  }
+  if (json_model_params.contains("delta_e_cache_size")) {
+    delta_e_cache_size =
+        json_model_params["delta_e_cache_size"].template get<int>();
+  }
+  if (json_model_params.contains("site_energy_bias")) {
+    site_energy_bias =
+        json_model_params["site_energy_bias"].template get<double>();
+  }
+  if (json_model_params.contains("prefetch_option")) {
+    prefetch_option = json_model_params["prefetch_option"].template get<bool>();
+  }
+  if (json_model_params.contains("sparse_option")) {
+    sparse_option = json_model_params["sparse_option"].template get<bool>();
+  }
+  if (sparse_option and site_energy_bias != 0.0) {
+    std::cerr << "Energy-biased picks need a dense state\n";
+    exit(1);
+  }
+  if (move_probas[mc_moves::insert_remove] > 0
+      and chemical_potentials.size() != static_cast<std::size_t>(n_types))
+  {
+    std::cerr << "insert_remove moves need one chemical potential per "
+                 "particle type\n";
+    exit(1);
+  }
 }
 
 std::ostream &operator<<(std::ostream &out, model_parameters_struct &params) {
@@ -51,7 +100,8 @@ std::ostream &operator<<(std::ostream &out, model_parameters_struct &params) {
   array_space::print_vector(out, params.couplings);
   out << "]\n";
   out << "Chosen initialize option: " << params.initialize_option << '\n';
-  if (params.initialize_option == "from_file") {
+  if (params.initialize_option == "from_file"
+      or params.initialize_option == "warm_start") {
     out << "Initialized from file " << params.state_input << '\n';
   }
   out << "Move probabilities: ";
@@ -0,0 +1,230 @@
+#include "particles_quench.h"
+#include "particles_update.h"
+
+#include <queue>
+#include <vector>
+
+namespace particles_space {
+
+long quench_system(state_struct& state,
+                   interactions_struct& interactions,
+                   model_parameters_struct& parameters,
+                   geometry_space::Geometry& geometry)
+{
+  // Energy changes smaller than this are rounding errors, not downhill moves
+  const double tolerance {1e-9};
+  const std::size_t n_sites {static_cast<std::size_t>(state.n_sites)};
+  const int n_neighbours {geometry.get_n_neighbours()};
+
+  // A queue entry is valid only if the stamp of its site did not change since
+  // it was evaluated
+  vec1i stamps(n_sites, 0);
+  // Index of the last move for which each site was collected, to visit every
+  // affected site once
+  std::vector<long> last_visit(n_sites, -1);
+  vec1i affected_sites {};
+  vec1d state_energies {};
+  std::priority_queue<quench_move_struct,
+                      std::vector<quench_move_struct>,
+                      quench_move_compare>
+      moves {};
+
+  for (int site {0}; site < state.n_sites; site++) {
+    if (state.lattice_sites.is_empty(site)) {
+      continue;
+    }
+    quench_move_struct move {get_best_site_move(
+        state, interactions, parameters, geometry, site, state_energies)};
+    if (move.delta_e < -tolerance) {
+      moves.push(move);
+    }
+  }
+
+  long n_moves {0};
+  while (!moves.empty()) {
+    quench_move_struct move {moves.top()};
+    moves.pop();
+    if (move.stamp != stamps[static_cast<std::size_t>(move.site)]) {
+      continue;
+    }
+
+    // Apply the move
+    if (move.partner == -1) {
+      set_particle_type(state, move.site,
+                        move.new_state / state.n_orientations);
+      state.lattice_sites.set_orientation(
+          move.site, move.new_state % state.n_orientations);
+    } else if (state.lattice_sites.is_empty(move.partner)) {
+      swap_sites(state, move.site, move.partner);
+      state.lattice_sites.set_orientation(
+          move.partner, move.new_state % state.n_orientations);
+    } else {
+      swap_sites(state, move.site, move.partner);
+    }
+    interactions.energy += move.delta_e;
+
+    // Collect the sites up to two bonds away from the modified ones
+    affected_sites.clear();
+    for (int changed_site : {move.site, move.partner}) {
+      if (changed_site == -1) {
+        continue;
+      }
+      std::size_t u_changed_site {static_cast<std::size_t>(changed_site)};
+      if (last_visit[u_changed_site] != n_moves) {
+        last_visit[u_changed_site] = n_moves;
+        affected_sites.push_back(changed_site);
+      }
+      for (int bond_1 {0}; bond_1 < n_neighbours; bond_1++) {
+        int neighbour_1 {geometry.get_neighbour(changed_site, bond_1)};
+        std::size_t u_neighbour_1 {static_cast<std::size_t>(neighbour_1)};
+        if (last_visit[u_neighbour_1] != n_moves) {
+          last_visit[u_neighbour_1] = n_moves;
+          affected_sites.push_back(neighbour_1);
+        }
+        for (int bond_2 {0}; bond_2 < n_neighbours; bond_2++) {
+          int neighbour_2 {geometry.get_neighbour(neighbour_1, bond_2)};
+          std::size_t u_neighbour_2 {static_cast<std::size_t>(neighbour_2)};
+          if (last_visit[u_neighbour_2] != n_moves) {
+            last_visit[u_neighbour_2] = n_moves;
+            affected_sites.push_back(neighbour_2);
+          }
+        }
+      }
+    }
+    n_moves++;
+
+    // Evaluate their moves again
+    for (int site : affected_sites) {
+      std::size_t u_site {static_cast<std::size_t>(site)};
+      stamps[u_site]++;
+      if (state.lattice_sites.is_empty(site)) {
+        continue;
+      }
+      quench_move_struct site_move {get_best_site_move(
+          state, interactions, parameters, geometry, site, state_energies)};
+      site_move.stamp = stamps[u_site];
+      if (site_move.delta_e < -tolerance) {
+        moves.push(site_move);
+      }
+    }
+  }
+  return n_moves;
+}
+
+quench_move_struct get_best_site_move(state_struct& state,
+                                      interactions_struct& interactions,
+                                      model_parameters_struct& parameters,
+                                      geometry_space::Geometry& geometry,
+                                      int site_index,
+                                      vec1d& state_energies)
+{
+  const move_probas_arr& probas {parameters.move_probas};
+  const bool allow_rotate {probas[mc_moves::rotate] > 0
+                           or probas[mc_moves::heat_bath_rotate] > 0};
+  const bool allow_mutate {probas[mc_moves::mutate] > 0
+                           or probas[mc_moves::heat_bath_mutate] > 0};
+  const bool allow_hop {probas[mc_moves::swap_empty_full] > 0
+                        or probas[mc_moves::rotate_and_swap_w_empty] > 0};
+  const bool allow_hop_rotate {
+      allow_rotate or probas[mc_moves::rotate_and_swap_w_empty] > 0};
+  const bool allow_exchange {probas[mc_moves::swap_full_full] > 0};
+
+  const int n_orientations {state.n_orientations};
+  const int old_type {state.lattice_sites.get_type(site_index)};
+  const int old_orientation {state.lattice_sites.get_orientation(site_index)};
+  const int old_state {old_orientation + n_orientations * old_type};
+
+  quench_move_struct best_move {};
+  best_move.site = site_index;
+  best_move.new_state = old_state;
+
+  // Moves in place
+  if (allow_rotate or allow_mutate) {
+    get_site_state_energies(
+        state, interactions, geometry, site_index, state_energies);
+    double old_energy {state_energies[static_cast<std::size_t>(old_state)]};
+    for (int new_state {0}; new_state < state.n_states; new_state++) {
+      bool rotated {new_state % n_orientations != old_orientation};
+      bool mutated {new_state / n_orientations != old_type};
+      if ((rotated and !allow_rotate) or (mutated and !allow_mutate)) {
+        continue;
+      }
+      double delta_e {state_energies[static_cast<std::size_t>(new_state)]
+                      - old_energy};
+      if (delta_e < best_move.delta_e) {
+        best_move.delta_e = delta_e;
+        best_move.partner = -1;
+        best_move.new_state = new_state;
+      }
+    }
+  }
+
+  if (!allow_hop and !allow_exchange) {
+    return best_move;
+  }
+
+  // Moves involving a neighbouring site. They are evaluated by making the
+  // swap in the site vector only, and undoing it.
+  double old_energy {get_site_energy(state, interactions, geometry, site_index)};
+  for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+    int neighbour {geometry.get_neighbour(site_index, bond)};
+    if (neighbour == site_index) {
+      continue;
+    }
+    if (state.lattice_sites.is_empty(neighbour)) {
+      if (!allow_hop) {
+        continue;
+      }
+      state.lattice_sites.swap_sites(site_index, neighbour);
+      int new_state {old_state};
+      double new_energy {};
+      if (allow_hop_rotate) {
+        // Best orientation of the particle on its new site
+        get_site_state_energies(
+            state, interactions, geometry, neighbour, state_energies);
+        new_energy = state_energies[static_cast<std::size_t>(old_state)];
+        for (int orientation {0}; orientation < n_orientations; orientation++) {
+          int candidate_state {orientation + n_orientations * old_type};
+          double candidate_energy {
+              state_energies[static_cast<std::size_t>(candidate_state)]};
+          if (candidate_energy < new_energy) {
+            new_energy = candidate_energy;
+            new_state = candidate_state;
+          }
+        }
+      } else {
+        new_energy = get_site_energy(state, interactions, geometry, neighbour);
+      }
+      state.lattice_sites.swap_sites(site_index, neighbour);
+
+      double delta_e {new_energy - old_energy};
+      if (delta_e < best_move.delta_e) {
+        best_move.delta_e = delta_e;
+        best_move.partner = neighbour;
+        best_move.new_state = new_state;
+      }
+    } else if (allow_exchange) {
+      if (state.lattice_sites.get_type(neighbour) == old_type
+          and state.lattice_sites.get_orientation(neighbour) == old_orientation)
+      {
+        continue;
+      }
+      int pair_bond {geometry.get_bond(site_index, neighbour)};
+      double delta_e {-measure_pair_energy(
+          site_index, neighbour, pair_bond, state, interactions, geometry)};
+      state.lattice_sites.swap_sites(site_index, neighbour);
+      delta_e += measure_pair_energy(
+          site_index, neighbour, pair_bond, state, interactions, geometry);
+      state.lattice_sites.swap_sites(site_index, neighbour);
+
+      if (delta_e < best_move.delta_e) {
+        best_move.delta_e = delta_e;
+        best_move.partner = neighbour;
+        best_move.new_state = old_state;
+      }
+    }
+  }
+  return best_move;
+}
+
+}  // namespace particles_space
@@ -29,4 +29,30 @@ void save_records(model_parameters_struct& parameters,
   }
 }
 
+void initialize_best_state(state_struct& state,
+                           interactions_struct& interactions,
+                           records_struct& records)
+{
+  records.best_energy = interactions.energy;
+  // Assignment reuses the storage of the previous copy
+  records.best_sites = state.lattice_sites;
+}
+
+void save_best_state(state_struct& state,
+                     records_struct& records,
+                     std::string& state_output)
+{
+  state_struct best_state {state};
+  best_state.lattice_sites = records.best_sites;
+  save_state(best_state, state_output);
+}
+
+void restore_best_state(state_struct& state,
+                        interactions_struct& interactions,
+                        records_struct& records)
+{
+  reset_state_sites(state, records.best_sites);
+  interactions.energy = records.best_energy;
+}
+
 }  // namespace particles_space
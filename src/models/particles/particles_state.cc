@@ -1,8 +1,10 @@
 #include "particles_state.h"
 #include "vector_utils.h"
+#include <algorithm>
 #include <cstddef>
 #include <numeric>
 #include <sstream>
+#include <vector>
 
 /*
  * Definitions required for the public routines of the model class
@@ -22,6 +24,7 @@ void initialize_state(state_struct& state,
   state.n_particles = parameters.n_particles;
   state.n_states = state.n_types * state.n_orientations;
   state.n_sites = geometry.get_n_sites();
+  state.site_of_row_major = geometry.get_site_of_row_major();
   std::string option = parameters.initialize_option;
   state.lattice_sites = SiteVector(option, state, parameters);
   state.full_empty_sites = FullEmptySites(state);
@@ -35,15 +38,22 @@ void save_state(state_struct& state, std::string& state_output)
     std::cerr << "Could not open " + state_output << std::endl;
     exit(1);
   }
+  // Sites are written in row-major order, whatever their order in memory
+  vec1i sites(static_cast<std::size_t>(state.n_sites));
+  if (state.site_of_row_major.empty()) {
+    std::iota(sites.begin(), sites.end(), 0);
+  } else {
+    sites = state.site_of_row_major;
+  }
   // Record the particle types on line 1
-  for (int i {0}; i < state.n_sites; i++) {
-    state_f << state.lattice_sites.get_type(i) << ' ';
+  for (int site : sites) {
+    state_f << state.lattice_sites.get_type(site) << ' ';
   }
 
   state_f << '\n';
   // And the particle orientations on line 2
-  for (int i {0}; i < state.n_sites; i++) {
-    state_f << state.lattice_sites.get_orientation(i) << ' ';
+  for (int site : sites) {
+    state_f << state.lattice_sites.get_orientation(site) << ' ';
   }
   state_f << '\n';
   state_f.close();
@@ -64,9 +74,84 @@ void initialize_state_from_file(vec1i& types,
                                 vec1i& orientations,
                                 model_parameters_struct& parameters)
 {
-  std::ifstream input_file {parameters.state_input};
+  read_state_file(types, orientations, parameters.state_input);
+}
+
+void initialize_state_warm_start(vec1i& types,
+                                 vec1i& orientations,
+                                 state_struct& state,
+                                 model_parameters_struct& parameters)
+{
+  read_state_file(types, orientations, parameters.state_input);
+  if (static_cast<int>(orientations.size()) != state.n_sites
+      or types.size() != orientations.size())
+  {
+    std::cerr << "The structure in " + parameters.state_input
+                     + " does not match the lattice size\n";
+    exit(1);
+  }
+
+  // Sites holding each type, and empty sites
+  std::size_t n_types {static_cast<std::size_t>(parameters.n_types)};
+  std::vector<vec1s> type_sites(n_types);
+  vec1s empty_sites {};
+  int n_removed {0};
+  for (std::size_t site {0}; site < orientations.size(); site++) {
+    if (orientations[site] == -1) {
+      empty_sites.push_back(site);
+    } else if (types[site] < 0
+               or types[site] >= parameters.n_types)
+    {
+      types[site] = 0;
+      orientations[site] = -1;
+      empty_sites.push_back(site);
+      n_removed++;
+    } else {
+      type_sites[static_cast<std::size_t>(types[site])].push_back(site);
+    }
+  }
+
+  // Remove the particles in excess first, so that their sites can be reused
+  for (std::size_t type {0}; type < n_types; type++) {
+    std::size_t target {static_cast<std::size_t>(parameters.n_particles[type])};
+    vec1s& sites {type_sites[type]};
+    std::shuffle(sites.begin(), sites.end(), parameters.rng);
+    while (sites.size() > target) {
+      types[sites.back()] = 0;
+      orientations[sites.back()] = -1;
+      empty_sites.push_back(sites.back());
+      sites.pop_back();
+      n_removed++;
+    }
+  }
+
+  int_dist orientation_dist(0, state.n_orientations - 1);
+  std::shuffle(empty_sites.begin(), empty_sites.end(), parameters.rng);
+  int n_added {0};
+  for (std::size_t type {0}; type < n_types; type++) {
+    std::size_t target {static_cast<std::size_t>(parameters.n_particles[type])};
+    for (std::size_t n {type_sites[type].size()}; n < target; n++) {
+      if (empty_sites.empty()) {
+        std::cerr << "Too many particles for the lattice\n";
+        exit(1);
+      }
+      types[empty_sites.back()] = static_cast<int>(type);
+      orientations[empty_sites.back()] = orientation_dist(parameters.rng);
+      empty_sites.pop_back();
+      n_added++;
+    }
+  }
+  std::cout << "Warm start from " << parameters.state_input << ": "
+            << n_removed << " particles removed, " << n_added << " added\n";
+}
+
+void read_state_file(vec1i& types,
+                     vec1i& orientations,
+                     const std::string& state_input)
+{
+  std::ifstream input_file {state_input};
   if (!input_file) {
-    std::cerr << "Unable to open file " + parameters.state_input;
+    std::cerr << "Unable to open file " + state_input;
     exit(1);
   }
   // Fetching the orientations one by one
@@ -88,6 +173,52 @@ void initialize_state_from_file(vec1i& types,
   input_file.close();
 }
 
+void reorder_from_row_major(const vec1i& site_of_row_major, vec1i& values)
+{
+  if (site_of_row_major.empty()) return;
+  if (values.size() != site_of_row_major.size()) {
+    std::cerr << "Wrong number of sites in the state file\n";
+    exit(1);
+  }
+  vec1i reordered(values.size());
+  for (std::size_t r {0}; r < values.size(); r++) {
+    reordered[static_cast<std::size_t>(site_of_row_major[r])] = values[r];
+  }
+  values = reordered;
+}
+
+void load_state(state_struct& state, const std::string& state_input)
+{
+  vec1i types {};
+  vec1i orientations {};
+  read_state_file(types, orientations, state_input);
+  if (static_cast<int>(orientations.size()) != state.n_sites) {
+    std::cerr << "Wrong number of sites in " + state_input << '\n';
+    exit(1);
+  }
+  reorder_from_row_major(state.site_of_row_major, types);
+  reorder_from_row_major(state.site_of_row_major, orientations);
+  SiteVector sites(types, orientations, state.n_orientations);
+  if (state.lattice_sites.is_sparse()) {
+    sites.make_sparse();
+  }
+  reset_state_sites(state, sites);
+}
+
+void reset_state_sites(state_struct& state, const SiteVector& sites)
+{
+  state.lattice_sites = sites;
+  state.full_empty_sites = FullEmptySites(state);
+  // Recount the particles of each type
+  state.n_particles.assign(static_cast<std::size_t>(state.n_types), 0);
+  const int n_full_sites {state.full_empty_sites.get_n_full_sites()};
+  for (std::size_t k {0}; k < static_cast<std::size_t>(n_full_sites); k++) {
+    int site {state.full_empty_sites.get_full_site(k)};
+    state.n_particles[static_cast<std::size_t>(
+        state.lattice_sites.get_type(site))]++;
+  }
+}
+
 void initialize_state_random_fixed_particle_numbers(
     vec1i& types,
     vec1i& orientations,
@@ -122,6 +253,35 @@ void initialize_state_random_fixed_particle_numbers(
   std::shuffle(orientations.begin(), orientations.end(), rng2);
 }
 
+void initialize_sparse_state_random_fixed_particle_numbers(
+    site_hash_space::SiteHashMap& site_states,
+    state_struct& state,
+    model_parameters_struct& parameters)
+{
+  int n_particles {std::accumulate(
+      parameters.n_particles.begin(), parameters.n_particles.end(), 0)};
+  if (n_particles > state.n_sites) {
+    std::cerr << "Too many particles for the lattice\n";
+    exit(1);
+  }
+  int_dist site_dist(0, state.n_sites - 1);
+  int_dist orientation_dist(0, state.n_orientations - 1);
+  // Each particle goes to a uniformly drawn empty site, found by rejection
+  for (int type {0}; type < parameters.n_types; type++) {
+    int n_particles_of_type {
+        parameters.n_particles[static_cast<std::size_t>(type)]};
+    for (int n {0}; n < n_particles_of_type; n++) {
+      int site {site_dist(parameters.rng)};
+      while (site_states.contains(site)) {
+        site = site_dist(parameters.rng);
+      }
+      site_states.set(site,
+                      orientation_dist(parameters.rng)
+                          + type * state.n_orientations);
+    }
+  }
+}
+
 /* ----------------------------------
  *SiteVector class method definitions
  *----------------------------------*/
@@ -134,9 +294,16 @@ SiteVector::SiteVector(std::string& option,
   try {
     if (option == "from_file") {
       initialize_state_from_file(types_m, orientations_m, parameters);
+    } else if (option == "random" and parameters.sparse_option) {
+      sparse_m = true;
+      initialize_sparse_state_random_fixed_particle_numbers(
+          site_states_m, state, parameters);
     } else if (option == "random") {
       initialize_state_random_fixed_particle_numbers(
           types_m, orientations_m, state, parameters);
+    } else if (option == "warm_start") {
+      initialize_state_warm_start(
+          types_m, orientations_m, state, parameters);
     } else {
       throw option;
     }
@@ -144,6 +311,14 @@ SiteVector::SiteVector(std::string& option,
     std::cout << "Incorrect initialization option: ''" << option << "''\n";
     exit(1);
   }
+  // State files list the sites in row-major order
+  if (option == "from_file" or option == "warm_start") {
+    reorder_from_row_major(state.site_of_row_major, types_m);
+    reorder_from_row_major(state.site_of_row_major, orientations_m);
+    if (parameters.sparse_option) {
+      make_sparse();
+    }
+  }
 }
 
 void print_state(state_struct& state)
@@ -153,6 +328,15 @@ void print_state(state_struct& state)
 
 void SiteVector::swap_sites(const int index1, const int index2)
 {
+  if (sparse_m) {
+    int state1 {site_states_m.get(index1)};
+    int state2 {site_states_m.get(index2)};
+    site_states_m.erase(index1);
+    site_states_m.erase(index2);
+    if (state2 != -1) site_states_m.set(index1, state2);
+    if (state1 != -1) site_states_m.set(index2, state1);
+    return;
+  }
   std::size_t u_index1 {static_cast<std::size_t>(index1)};
   std::size_t u_index2 {static_cast<std::size_t>(index2)};
 
@@ -161,6 +345,10 @@ void SiteVector::swap_sites(const int index1, const int index2)
 }
 
 int SiteVector::get_state(const int site_index) const {
+  // The hash table stores the state itself, -1 if empty
+  if (sparse_m) {
+    return site_states_m.get(site_index);
+  }
   // If site is empty, we'll return -1
   int state{-1};
   // Else we recycle Andrey's function to hash 2 integers into 1
@@ -174,12 +362,50 @@ int SiteVector::get_state(const int site_index) const {
   return state;
 }
 
+void SiteVector::set_sparse_site(const int site_index,
+                                 const int new_type,
+                                 const int new_orientation)
+{
+  if (new_orientation == -1) {
+    site_states_m.erase(site_index);
+  } else {
+    site_states_m.set(site_index,
+                      new_orientation + new_type * n_orientations_m);
+  }
+}
+
+void SiteVector::make_sparse()
+{
+  if (sparse_m) {
+    return;
+  }
+  site_states_m.clear();
+  for (std::size_t i {0}; i < orientations_m.size(); i++) {
+    if (orientations_m[i] != -1) {
+      site_states_m.set(static_cast<int>(i),
+                        orientations_m[i] + types_m[i] * n_orientations_m);
+    }
+  }
+  vec1i().swap(types_m);
+  vec1i().swap(orientations_m);
+  sparse_m = true;
+}
+
 /* ---------------------------------------
  * FullEmptySites class method definitions
  * ---------------------------------------*/
 
 FullEmptySites::FullEmptySites(state_struct& state)
 {
+  if (state.lattice_sites.is_sparse()) {
+    sparse_m = true;
+    n_sites_m = state.n_sites;
+    for (int site : state.lattice_sites.get_full_sites()) {
+      full_positions_m.set(site, static_cast<int>(full_sites_indices_m.size()));
+      full_sites_indices_m.push_back(static_cast<std::size_t>(site));
+    }
+    return;
+  }
   site_inds_to_full_empty_m = vec1s(static_cast<std::size_t>(state.n_sites));
   std::cout << state.n_sites << "\n";
   for (int i {0}; i < state.n_sites; i++) {
@@ -196,14 +422,38 @@ FullEmptySites::FullEmptySites(state_struct& state)
 
 int FullEmptySites::get_random_full_site(model_parameters_struct& parameters)
 {
+  if (!full_sites_ahead_m.empty()) {
+    std::size_t position {full_sites_ahead_m.front()};
+    full_sites_ahead_m.erase(full_sites_ahead_m.begin());
+    return static_cast<int>(full_sites_indices_m[position]);
+  }
   int n_full_sites {static_cast<int>(full_sites_indices_m.size())};
   int_dist full_sites_dist(0, n_full_sites - 1);
   return static_cast<int>(full_sites_indices_m[static_cast<std::size_t>(
       full_sites_dist(parameters.rng))]);
 }
 
+void FullEmptySites::draw_full_site_ahead(model_parameters_struct& parameters)
+{
+  int n_full_sites {static_cast<int>(full_sites_indices_m.size())};
+  int_dist full_sites_dist(0, n_full_sites - 1);
+  full_sites_ahead_m.push_back(
+      static_cast<std::size_t>(full_sites_dist(parameters.rng)));
+  array_space::prefetch_address(
+      &full_sites_indices_m[full_sites_ahead_m.back()]);
+}
+
 int FullEmptySites::get_random_empty_site(model_parameters_struct& parameters)
 {
+  if (sparse_m) {
+    // Uniform among the empty sites, in about n_sites / n_empty_sites draws
+    int_dist sites_dist(0, n_sites_m - 1);
+    int site {sites_dist(parameters.rng)};
+    while (full_positions_m.contains(site)) {
+      site = sites_dist(parameters.rng);
+    }
+    return site;
+  }
   int n_empty_sites {static_cast<int>(empty_sites_indices_m.size())};
   int_dist empty_sites_dist(0, n_empty_sites - 1);
   return static_cast<int>(empty_sites_indices_m[static_cast<std::size_t>(
@@ -213,6 +463,14 @@ int FullEmptySites::get_random_empty_site(model_parameters_struct& parameters)
 void FullEmptySites::update_after_swap(const int initially_full_site,
                                        const int initially_empty_site)
 {
+  if (sparse_m) {
+    int position {full_positions_m.get(initially_full_site)};
+    full_sites_indices_m[static_cast<std::size_t>(position)] =
+        static_cast<std::size_t>(initially_empty_site);
+    full_positions_m.erase(initially_full_site);
+    full_positions_m.set(initially_empty_site, position);
+    return;
+  }
   const std::size_t u_initially_empty_site {
       static_cast<std::size_t>(initially_empty_site)};
   const std::size_t u_initially_full_site {
@@ -232,6 +490,389 @@ void FullEmptySites::update_after_swap(const int initially_full_site,
   site_inds_to_full_empty_m[u_initially_full_site] = index_in_empty_arr;
 }
 
+void FullEmptySites::update_after_insertion(const int site_index)
+{
+  full_sites_ahead_m.clear();
+  if (sparse_m) {
+    full_positions_m.set(site_index,
+                         static_cast<int>(full_sites_indices_m.size()));
+    full_sites_indices_m.push_back(static_cast<std::size_t>(site_index));
+    return;
+  }
+  move_site(site_index, empty_sites_indices_m, full_sites_indices_m);
+}
+
+void FullEmptySites::update_after_removal(const int site_index)
+{
+  full_sites_ahead_m.clear();
+  if (sparse_m) {
+    // Fill the hole with the last full site
+    int position {full_positions_m.get(site_index)};
+    std::size_t last_site {full_sites_indices_m.back()};
+    full_sites_indices_m[static_cast<std::size_t>(position)] = last_site;
+    full_positions_m.set(static_cast<int>(last_site), position);
+    full_sites_indices_m.pop_back();
+    full_positions_m.erase(site_index);
+    return;
+  }
+  move_site(site_index, full_sites_indices_m, empty_sites_indices_m);
+}
+
+void FullEmptySites::move_site(const int site_index, vec1s& from, vec1s& to)
+{
+  const std::size_t u_site_index {static_cast<std::size_t>(site_index)};
+  const std::size_t index_in_from {site_inds_to_full_empty_m[u_site_index]};
+  const std::size_t last_site {from.back()};
+  from[index_in_from] = last_site;
+  site_inds_to_full_empty_m[last_site] = index_in_from;
+  from.pop_back();
+  to.push_back(u_site_index);
+  site_inds_to_full_empty_m[u_site_index] = to.size() - 1;
+}
+
+int get_largest_cluster_size(state_struct& state,
+                             geometry_space::Geometry& geometry)
+{
+  // Visited sites are flagged in a per-site vector, or in a hash table of the
+  // full sites if the state is sparse
+  const bool sparse {state.lattice_sites.is_sparse()};
+  std::vector<bool> visited(
+      sparse ? 0 : static_cast<std::size_t>(state.n_sites), false);
+  site_hash_space::SiteHashMap visited_sparse {};
+  auto visit = [&](int site) {
+    if (sparse) {
+      if (visited_sparse.contains(site)) return false;
+      visited_sparse.set(site, 1);
+      return true;
+    }
+    if (visited[static_cast<std::size_t>(site)]) return false;
+    visited[static_cast<std::size_t>(site)] = true;
+    return true;
+  };
+  vec1i stack {};
+  int largest_size {0};
+  const int n_full_sites {state.full_empty_sites.get_n_full_sites()};
+  for (std::size_t k {0}; k < static_cast<std::size_t>(n_full_sites); k++) {
+    int site {state.full_empty_sites.get_full_site(k)};
+    if (!visit(site)) {
+      continue;
+    }
+    // Depth-first search of the cluster containing site
+    int cluster_size {0};
+    stack.push_back(site);
+    while (!stack.empty()) {
+      int current {stack.back()};
+      stack.pop_back();
+      cluster_size++;
+      for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+        int neighbour {geometry.get_neighbour(current, bond)};
+        if (!state.lattice_sites.is_empty(neighbour) and visit(neighbour)) {
+          stack.push_back(neighbour);
+        }
+      }
+    }
+    largest_size = std::max(largest_size, cluster_size);
+  }
+  return largest_size;
+}
+
+ClusterTracker::ClusterTracker(state_struct& state,
+                               geometry_space::Geometry& geometry)
+{
+  sparse_m = state.lattice_sites.is_sparse();
+  if (!sparse_m) {
+    labels_m.assign(static_cast<std::size_t>(state.n_sites), -1);
+  }
+  const int n_full_sites {state.full_empty_sites.get_n_full_sites()};
+  for (std::size_t k {0}; k < static_cast<std::size_t>(n_full_sites); k++) {
+    int site {state.full_empty_sites.get_full_site(k)};
+    if (get_label(site) != -1) {
+      continue;
+    }
+    // Depth-first search of the cluster containing site
+    int label {get_new_label()};
+    int cluster_size {0};
+    set_label(site, label);
+    stack_m.push_back(site);
+    while (!stack_m.empty()) {
+      int current {stack_m.back()};
+      stack_m.pop_back();
+      cluster_size++;
+      for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+        int neighbour {geometry.get_neighbour(current, bond)};
+        if (!state.lattice_sites.is_empty(neighbour)
+            and get_label(neighbour) == -1)
+        {
+          set_label(neighbour, label);
+          stack_m.push_back(neighbour);
+        }
+      }
+    }
+    cluster_sizes_m[static_cast<std::size_t>(label)] = cluster_size;
+    add_cluster_size(cluster_size);
+  }
+}
+
+void ClusterTracker::update_after_insertion(geometry_space::Geometry& geometry,
+                                            const int site_index)
+{
+  // The site joins the largest neighbouring cluster, into which the other
+  // ones are merged
+  neighbours_m.clear();
+  int label {-1};
+  int new_size {1};
+  for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+    int neighbour_label {get_label(geometry.get_neighbour(site_index, bond))};
+    if (neighbour_label == -1
+        or std::find(neighbours_m.begin(), neighbours_m.end(), neighbour_label)
+            != neighbours_m.end())
+    {
+      continue;
+    }
+    neighbours_m.push_back(neighbour_label);
+    int size {cluster_sizes_m[static_cast<std::size_t>(neighbour_label)]};
+    new_size += size;
+    if (label == -1 or size > cluster_sizes_m[static_cast<std::size_t>(label)])
+    {
+      label = neighbour_label;
+    }
+  }
+  if (label == -1) {
+    label = get_new_label();
+  }
+  add_cluster_size(new_size);
+  for (int neighbour_label : neighbours_m) {
+    remove_cluster_size(
+        cluster_sizes_m[static_cast<std::size_t>(neighbour_label)]);
+    if (neighbour_label == label) {
+      continue;
+    }
+    for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+      int neighbour {geometry.get_neighbour(site_index, bond)};
+      if (get_label(neighbour) == neighbour_label) {
+        relabel_cluster(geometry, neighbour, neighbour_label, label);
+        break;
+      }
+    }
+    free_labels_m.push_back(neighbour_label);
+  }
+  cluster_sizes_m[static_cast<std::size_t>(label)] = new_size;
+  set_label(site_index, label);
+}
+
+void ClusterTracker::update_after_removal(geometry_space::Geometry& geometry,
+                                          const int site_index)
+{
+  const int label {get_label(site_index)};
+  const int old_size {cluster_sizes_m[static_cast<std::size_t>(label)]};
+  set_label(site_index, -1);
+  neighbours_m.clear();
+  for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+    int neighbour {geometry.get_neighbour(site_index, bond)};
+    if (get_label(neighbour) == label
+        and std::find(neighbours_m.begin(), neighbours_m.end(), neighbour)
+            == neighbours_m.end())
+    {
+      neighbours_m.push_back(neighbour);
+    }
+  }
+
+  // With a single neighbour in the cluster, the cluster cannot split
+  if (neighbours_m.size() <= 1) {
+    if (old_size > 1) {
+      add_cluster_size(old_size - 1);
+    } else {
+      free_labels_m.push_back(label);
+    }
+    remove_cluster_size(old_size);
+    cluster_sizes_m[static_cast<std::size_t>(label)] = old_size - 1;
+    return;
+  }
+
+  // Breadth-first searches from every neighbour, which give a temporary label
+  // to the sites they find
+  const std::size_t n_searches {neighbours_m.size()};
+  if (search_sites_m.size() < n_searches) {
+    search_sites_m.resize(n_searches);
+    search_heads_m.resize(n_searches);
+    search_labels_m.resize(n_searches);
+    search_parents_m.resize(n_searches);
+  }
+  for (std::size_t i {0}; i < n_searches; i++) {
+    search_sites_m[i].assign(1, neighbours_m[i]);
+    search_heads_m[i] = 0;
+    search_labels_m[i] = get_new_label();
+    search_parents_m[i] = i;
+    set_label(neighbours_m[i], search_labels_m[i]);
+  }
+  auto get_root = [&](std::size_t i) {
+    while (search_parents_m[i] != i) {
+      i = search_parents_m[i];
+    }
+    return i;
+  };
+  // Number of fragments which may still grow, counted up to 2, and the root
+  // of the searches of the first one
+  auto get_running_root = [&](std::size_t& n_running) {
+    n_running = 0;
+    std::size_t running_root {n_searches};
+    for (std::size_t i {0}; i < n_searches and n_running < 2; i++) {
+      if (search_heads_m[i] == search_sites_m[i].size()) {
+        continue;
+      }
+      if (n_running == 0) {
+        running_root = get_root(i);
+        n_running = 1;
+      } else if (get_root(i) != running_root) {
+        n_running = 2;
+      }
+    }
+    return running_root;
+  };
+
+  // The searches take one step each in turn. Two searches which meet are in
+  // the same fragment and are merged. A fragment is complete when all the
+  // neighbours of the sites found by its searches were visited
+  std::size_t n_running {n_searches};
+  std::size_t running_root {get_running_root(n_running)};
+  while (n_running > 1) {
+    for (std::size_t i {0}; i < n_searches; i++) {
+      vec1i& sites {search_sites_m[i]};
+      if (search_heads_m[i] == sites.size()) {
+        continue;
+      }
+      int current {sites[search_heads_m[i]++]};
+      for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+        int neighbour {geometry.get_neighbour(current, bond)};
+        int neighbour_label {get_label(neighbour)};
+        if (neighbour_label == label) {
+          set_label(neighbour, search_labels_m[i]);
+          sites.push_back(neighbour);
+        } else if (neighbour_label != -1
+                   and neighbour_label != search_labels_m[i])
+        {
+          std::size_t j {static_cast<std::size_t>(
+              std::find(search_labels_m.begin(),
+                        search_labels_m.begin()
+                            + static_cast<std::ptrdiff_t>(n_searches),
+                        neighbour_label)
+              - search_labels_m.begin())};
+          std::size_t root_i {get_root(i)};
+          std::size_t root_j {get_root(j)};
+          if (root_i != root_j) {
+            search_parents_m[root_j] = root_i;
+          }
+        }
+      }
+    }
+    running_root = get_running_root(n_running);
+  }
+
+  // The fragment still growing, or else the largest one, keeps the label of
+  // the cluster. The other ones are labelled after the root of their
+  // searches
+  for (std::size_t i {0}; i < n_searches; i++) {
+    std::size_t root {get_root(i)};
+    cluster_sizes_m[static_cast<std::size_t>(search_labels_m[root])] +=
+        static_cast<int>(search_sites_m[i].size());
+  }
+  if (n_running == 0) {
+    int largest_fragment {0};
+    for (std::size_t i {0}; i < n_searches; i++) {
+      int size {cluster_sizes_m[static_cast<std::size_t>(search_labels_m[i])]};
+      if (search_parents_m[i] == i and size > largest_fragment) {
+        largest_fragment = size;
+        running_root = i;
+      }
+    }
+  }
+  int split_size {0};
+  for (std::size_t i {0}; i < n_searches; i++) {
+    std::size_t root {get_root(i)};
+    int new_label {root == running_root ? label : search_labels_m[root]};
+    if (new_label != search_labels_m[i]) {
+      for (int site : search_sites_m[i]) {
+        set_label(site, new_label);
+      }
+      cluster_sizes_m[static_cast<std::size_t>(search_labels_m[i])] = 0;
+      free_labels_m.push_back(search_labels_m[i]);
+    } else {
+      int size {cluster_sizes_m[static_cast<std::size_t>(new_label)]};
+      add_cluster_size(size);
+      split_size += size;
+    }
+  }
+  add_cluster_size(old_size - 1 - split_size);
+  remove_cluster_size(old_size);
+  cluster_sizes_m[static_cast<std::size_t>(label)] = old_size - 1 - split_size;
+}
+
+void ClusterTracker::set_label(const int site_index, const int label)
+{
+  if (sparse_m) {
+    if (label == -1) {
+      labels_sparse_m.erase(site_index);
+    } else {
+      labels_sparse_m.set(site_index, label);
+    }
+    return;
+  }
+  labels_m[static_cast<std::size_t>(site_index)] = label;
+}
+
+int ClusterTracker::get_new_label()
+{
+  if (free_labels_m.empty()) {
+    cluster_sizes_m.push_back(0);
+    return static_cast<int>(cluster_sizes_m.size()) - 1;
+  }
+  int label {free_labels_m.back()};
+  free_labels_m.pop_back();
+  cluster_sizes_m[static_cast<std::size_t>(label)] = 0;
+  return label;
+}
+
+void ClusterTracker::relabel_cluster(geometry_space::Geometry& geometry,
+                                     const int site_index,
+                                     const int old_label,
+                                     const int label)
+{
+  set_label(site_index, label);
+  stack_m.push_back(site_index);
+  while (!stack_m.empty()) {
+    int current {stack_m.back()};
+    stack_m.pop_back();
+    for (int bond {0}; bond < geometry.get_n_neighbours(); bond++) {
+      int neighbour {geometry.get_neighbour(current, bond)};
+      if (get_label(neighbour) == old_label) {
+        set_label(neighbour, label);
+        stack_m.push_back(neighbour);
+      }
+    }
+  }
+}
+
+void ClusterTracker::add_cluster_size(const int n)
+{
+  if (size_counts_m.size() <= static_cast<std::size_t>(n)) {
+    size_counts_m.resize(static_cast<std::size_t>(n) + 1, 0);
+  }
+  size_counts_m[static_cast<std::size_t>(n)]++;
+  largest_size_m = std::max(largest_size_m, n);
+}
+
+void ClusterTracker::remove_cluster_size(const int n)
+{
+  size_counts_m[static_cast<std::size_t>(n)]--;
+  // Sizes are added before the ones they replace are removed, so this search
+  // is short
+  while (largest_size_m > 0
+         and size_counts_m[static_cast<std::size_t>(largest_size_m)] == 0)
+  {
+    largest_size_m--;
+  }
+}
+
 void swap_sites(state_struct& state, int site_1_index, int site_2_index)
 {
   state.lattice_sites.swap_sites(site_1_index, site_2_index);
@@ -244,6 +885,33 @@ void swap_sites(state_struct& state, int site_1_index, int site_2_index)
   }
 }
 
+void insert_particle(state_struct& state,
+                     int site_index,
+                     int type,
+                     int orientation)
+{
+  state.lattice_sites.set_site(site_index, type, orientation);
+  state.full_empty_sites.update_after_insertion(site_index);
+  state.n_particles[static_cast<std::size_t>(type)]++;
+}
+
+void remove_particle(state_struct& state, int site_index)
+{
+  int type {state.lattice_sites.get_type(site_index)};
+  // Empty sites are stored with type 0
+  state.lattice_sites.set_site(site_index, 0, -1);
+  state.full_empty_sites.update_after_removal(site_index);
+  state.n_particles[static_cast<std::size_t>(type)]--;
+}
+
+void set_particle_type(state_struct& state, int site_index, int new_type)
+{
+  state.n_particles[static_cast<std::size_t>(
+      state.lattice_sites.get_type(site_index))]--;
+  state.lattice_sites.set_type(site_index, new_type);
+  state.n_particles[static_cast<std::size_t>(new_type)]++;
+}
+
 std::ostream &operator<<(std::ostream &out, state_struct &state) {
   out << "Printing current system state\n";
   out << "Number of particle types: " << state.n_types << '\n';
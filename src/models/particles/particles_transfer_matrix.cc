@@ -0,0 +1,334 @@
+#include "particles_transfer_matrix.h"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+
+namespace particles_space {
+
+void initialize_transfer_matrix(transfer_matrix_struct& transfer_matrix,
+                                state_struct& state,
+                                interactions_struct& interactions,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry)
+{
+  // Largest transfer matrix we accept, to keep its memory below ~300 MB
+  const int max_column_states {4096};
+
+  geometry_space::lattice_options lattice {geometry.get_lattice()};
+  bool is_strip {(lattice == geometry_space::lattice_options::square
+                  or lattice == geometry_space::lattice_options::triangular)
+                 and geometry.get_lz() == 1};
+  bool is_chain {lattice == geometry_space::lattice_options::chain
+                 and geometry.get_ly() == 1 and geometry.get_lz() == 1};
+  if (!is_strip and !is_chain) {
+    std::cerr << "The transfer matrix needs a chain, or a square or "
+                 "triangular lattice with lz = 1\n";
+    exit(1);
+  }
+  transfer_matrix.width = geometry.get_ly();
+
+  // One-site states
+  transfer_matrix.chemical_potentials = parameters.chemical_potentials;
+  transfer_matrix.site_types.clear();
+  transfer_matrix.site_orientations.clear();
+  if (transfer_matrix.chemical_potentials.empty()) {
+    // Every site would sum over all the types, which fixes the relative
+    // chemical potentials rather than the number of particles of each type
+    if (state.n_types > 1) {
+      std::cerr << "The transfer matrix needs the chemical_potentials model "
+                   "parameter when there are several particle types\n";
+      exit(1);
+    }
+    int n_particles {std::accumulate(
+        parameters.n_particles.begin(), parameters.n_particles.end(), 0)};
+    if (n_particles != state.n_sites) {
+      std::cerr << "The transfer matrix needs the chemical_potentials model "
+                   "parameter unless the lattice is full\n";
+      exit(1);
+    }
+  } else {
+    if (transfer_matrix.chemical_potentials.size()
+        != static_cast<std::size_t>(state.n_types)) {
+      std::cerr << "chemical_potentials needs one entry per particle type\n";
+      exit(1);
+    }
+    transfer_matrix.site_types.push_back(0);
+    transfer_matrix.site_orientations.push_back(-1);
+  }
+  for (int type {0}; type < state.n_types; type++) {
+    for (int orientation {0}; orientation < state.n_orientations;
+         orientation++) {
+      transfer_matrix.site_types.push_back(type);
+      transfer_matrix.site_orientations.push_back(orientation);
+    }
+  }
+  transfer_matrix.n_site_states =
+      static_cast<int>(transfer_matrix.site_types.size());
+
+  const int width {transfer_matrix.width};
+  const int n_site_states {transfer_matrix.n_site_states};
+  int n_column_states {1};
+  for (int row {0}; row < width; row++) {
+    if (n_column_states > max_column_states / n_site_states) {
+      std::cerr << "The strip is too wide for the transfer matrix: "
+                << n_site_states << "^" << width << " column states\n";
+      exit(1);
+    }
+    n_column_states *= n_site_states;
+  }
+  transfer_matrix.n_column_states = n_column_states;
+  const std::size_t n_columns {static_cast<std::size_t>(n_column_states)};
+
+  // Three columns of the strip: bonds from the middle column reach the
+  // middle column itself or the next one through periodic boundaries
+  // identical to those of the simulated lattice
+  geometry_space::Geometry strip {lattice, 3, width, 1};
+  const int n_neighbours {strip.get_n_neighbours()};
+
+  vec2i column_digits(n_columns, vec1i(static_cast<std::size_t>(width)));
+  for (std::size_t c {0}; c < n_columns; c++) {
+    int code {static_cast<int>(c)};
+    for (std::size_t row {0}; row < static_cast<std::size_t>(width); row++) {
+      column_digits[c][row] = code % n_site_states;
+      code /= n_site_states;
+    }
+  }
+
+  // Energy of the contact of a site in one-site state digit_1 with a
+  // neighbour in state digit_2 through bond
+  auto contact = [&](int digit_1, int bond, int digit_2) {
+    std::size_t u_1 {static_cast<std::size_t>(digit_1)};
+    std::size_t u_2 {static_cast<std::size_t>(digit_2)};
+    int orientation_1 {transfer_matrix.site_orientations[u_1]};
+    int orientation_2 {transfer_matrix.site_orientations[u_2]};
+    if (orientation_1 == -1 or orientation_2 == -1) {
+      return 0.0;
+    }
+    return strip.get_interaction(orientation_1,
+                                 transfer_matrix.site_types[u_1],
+                                 orientation_2,
+                                 transfer_matrix.site_types[u_2],
+                                 bond,
+                                 state.n_types,
+                                 interactions.couplings);
+  };
+
+  // Contacts inside a column, counted from both ends
+  vec1d column_energies(n_columns, 0.0);
+  for (std::size_t c {0}; c < n_columns; c++) {
+    for (int row {0}; row < width; row++) {
+      int site {1 + 3 * row};
+      for (int bond {0}; bond < n_neighbours; bond++) {
+        int neighbour {strip.get_neighbour(site, bond)};
+        if (neighbour % 3 != 1) {
+          continue;
+        }
+        column_energies[c] +=
+            0.5
+            * contact(column_digits[c][static_cast<std::size_t>(row)],
+                      bond,
+                      column_digits[c][static_cast<std::size_t>(neighbour / 3)]);
+      }
+    }
+  }
+
+  // Contacts between consecutive columns, also counted from both ends as
+  // in get_energy
+  transfer_matrix.pair_energies.assign(n_columns * n_columns, 0.0);
+  for (std::size_t c {0}; c < n_columns; c++) {
+    for (std::size_t next_c {0}; next_c < n_columns; next_c++) {
+      double energy {0.5 * (column_energies[c] + column_energies[next_c])};
+      for (int row {0}; row < width; row++) {
+        int site {1 + 3 * row};
+        for (int bond {0}; bond < n_neighbours; bond++) {
+          int neighbour {strip.get_neighbour(site, bond)};
+          if (neighbour % 3 != 2) {
+            continue;
+          }
+          int digit {column_digits[c][static_cast<std::size_t>(row)]};
+          int next_digit {
+              column_digits[next_c][static_cast<std::size_t>(neighbour / 3)]};
+          energy += 0.5
+                    * (contact(digit, bond, next_digit)
+                       + contact(next_digit,
+                                 strip.get_opposite_bond(bond),
+                                 digit));
+        }
+      }
+      transfer_matrix.pair_energies[c * n_columns + next_c] = energy;
+    }
+  }
+
+  transfer_matrix.column_particles.assign(
+      static_cast<std::size_t>(state.n_types), vec1d(n_columns, 0.0));
+  for (std::size_t c {0}; c < n_columns; c++) {
+    for (int digit : column_digits[c]) {
+      std::size_t u_digit {static_cast<std::size_t>(digit)};
+      if (transfer_matrix.site_orientations[u_digit] != -1) {
+        std::size_t type {
+            static_cast<std::size_t>(transfer_matrix.site_types[u_digit])};
+        transfer_matrix.column_particles[type][c] += 1.0;
+      }
+    }
+  }
+
+  transfer_matrix.right.assign(n_columns, 1.0 / static_cast<double>(n_columns));
+  transfer_matrix.left.assign(n_columns, 1.0 / static_cast<double>(n_columns));
+}
+
+double solve_transfer_matrix(transfer_matrix_struct& transfer_matrix,
+                             double T)
+{
+  const double tolerance {1e-13};
+  const int max_iterations {100000};
+  const std::size_t n_columns {
+      static_cast<std::size_t>(transfer_matrix.n_column_states)};
+  const vec1d& mu {transfer_matrix.chemical_potentials};
+
+  // Exponents of the weights, shifted by their largest value so that the
+  // weights cannot overflow
+  vec1d& weights {transfer_matrix.weights};
+  weights.resize(n_columns * n_columns);
+  for (std::size_t c {0}; c < n_columns; c++) {
+    for (std::size_t next_c {0}; next_c < n_columns; next_c++) {
+      double exponent {transfer_matrix.pair_energies[c * n_columns + next_c]};
+      for (std::size_t type {0}; type < mu.size(); type++) {
+        const vec1d& particles {transfer_matrix.column_particles[type]};
+        exponent -= 0.5 * mu[type] * (particles[c] + particles[next_c]);
+      }
+      weights[c * n_columns + next_c] = -exponent / T;
+    }
+  }
+  transfer_matrix.log_scale =
+      *std::max_element(weights.begin(), weights.end());
+  for (double& weight : weights) {
+    weight = std::exp(weight - transfer_matrix.log_scale);
+  }
+
+  // Power iterations on both sides. The weights are positive, so the
+  // eigenvectors of the largest eigenvalue are positive too
+  double eigenvalue {0.0};
+  vec1d product(n_columns);
+  for (bool transposed : {false, true}) {
+    vec1d& vector {transposed ? transfer_matrix.left : transfer_matrix.right};
+    bool converged {false};
+    for (int iteration {0}; iteration < max_iterations and !converged;
+         iteration++) {
+      std::fill(product.begin(), product.end(), 0.0);
+      for (std::size_t c {0}; c < n_columns; c++) {
+        const double* row {&weights[c * n_columns]};
+        if (transposed) {
+          for (std::size_t next_c {0}; next_c < n_columns; next_c++) {
+            product[next_c] += vector[c] * row[next_c];
+          }
+        } else {
+          double sum {0.0};
+          for (std::size_t next_c {0}; next_c < n_columns; next_c++) {
+            sum += row[next_c] * vector[next_c];
+          }
+          product[c] = sum;
+        }
+      }
+      double norm {std::accumulate(product.begin(), product.end(), 0.0)};
+      double vector_norm {std::accumulate(vector.begin(), vector.end(), 0.0)};
+      eigenvalue = norm / vector_norm;
+      double change {0.0};
+      double largest {0.0};
+      for (std::size_t c {0}; c < n_columns; c++) {
+        product[c] /= norm;
+        change = std::max(change, std::abs(product[c] - vector[c]));
+        largest = std::max(largest, product[c]);
+      }
+      vector.swap(product);
+      converged = change <= tolerance * largest;
+    }
+    if (!converged) {
+      std::cerr << "Transfer matrix eigenvector not converged at T = " << T
+                << '\n';
+    }
+  }
+  return std::log(eigenvalue) + transfer_matrix.log_scale;
+}
+
+double get_transfer_matrix_average(
+    transfer_matrix_struct& transfer_matrix,
+    double log_eigenvalue,
+    const std::function<double(int, int)>& column_quantity)
+{
+  const std::size_t n_columns {
+      static_cast<std::size_t>(transfer_matrix.n_column_states)};
+  const vec1d& left {transfer_matrix.left};
+  const vec1d& right {transfer_matrix.right};
+  double eigenvalue {std::exp(log_eigenvalue - transfer_matrix.log_scale)};
+
+  double average {0.0};
+  double overlap {0.0};
+  for (std::size_t c {0}; c < n_columns; c++) {
+    overlap += left[c] * right[c];
+    for (std::size_t next_c {0}; next_c < n_columns; next_c++) {
+      average += left[c] * transfer_matrix.weights[c * n_columns + next_c]
+                 * column_quantity(static_cast<int>(c),
+                                   static_cast<int>(next_c))
+                 * right[next_c];
+    }
+  }
+  return average / (eigenvalue * overlap);
+}
+
+vec2d get_exact_thermodynamics(state_struct& state,
+                               interactions_struct& interactions,
+                               model_parameters_struct& parameters,
+                               geometry_space::Geometry& geometry,
+                               const vec1d& temperatures)
+{
+  // Relative temperature step of the derivative giving the heat capacity
+  const double relative_step {1e-4};
+
+  transfer_matrix_struct transfer_matrix {};
+  initialize_transfer_matrix(
+      transfer_matrix, state, interactions, parameters, geometry);
+  const std::size_t n_columns {
+      static_cast<std::size_t>(transfer_matrix.n_column_states)};
+  const double width {static_cast<double>(transfer_matrix.width)};
+
+  auto pair_energy = [&](int c, int next_c) {
+    return transfer_matrix.pair_energies[static_cast<std::size_t>(c)
+                                             * n_columns
+                                         + static_cast<std::size_t>(next_c)];
+  };
+  auto energy_at = [&](double T) {
+    double log_eigenvalue {solve_transfer_matrix(transfer_matrix, T)};
+    return get_transfer_matrix_average(
+               transfer_matrix, log_eigenvalue, pair_energy)
+           / width;
+  };
+
+  vec2d results {};
+  for (double T : temperatures) {
+    double h {relative_step * T};
+    double heat_capacity {(energy_at(T + h) - energy_at(T - h)) / (2 * h)};
+
+    double log_eigenvalue {solve_transfer_matrix(transfer_matrix, T)};
+    vec1d line {T,
+                -T * log_eigenvalue / width,
+                get_transfer_matrix_average(
+                    transfer_matrix, log_eigenvalue, pair_energy)
+                    / width,
+                heat_capacity};
+    for (const vec1d& particles : transfer_matrix.column_particles) {
+      auto column_density = [&](int c, int next_c) {
+        return 0.5
+               * (particles[static_cast<std::size_t>(c)]
+                  + particles[static_cast<std::size_t>(next_c)]);
+      };
+      line.push_back(get_transfer_matrix_average(
+                         transfer_matrix, log_eigenvalue, column_density)
+                     / width);
+    }
+    results.push_back(line);
+  }
+  return results;
+}
+
+}  // namespace particles_space
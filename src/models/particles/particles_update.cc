@@ -1,6 +1,7 @@
 #include "particles_update.h"
 #include "particles_interactions.h"
 #include "particles_state.h"
+#include <algorithm>
 #include <iterator>
 /*#include <ranges>*/
 #include <stdexcept>
@@ -11,39 +12,86 @@ void update_system(state_struct& state,
                    interactions_struct& interactions,
                    model_parameters_struct& parameters,
                    geometry_space::Geometry& geometry,
+                   records_struct& records,
                    double T)
 {
   // Pick the kind of move we'll be making
   for (int i {0}; i < state.n_sites; i++) {
+    if (parameters.prefetch_option) {
+      prefetch_next_proposals(state, parameters, geometry);
+    }
     mc_moves chosen_move {pick_random_move(parameters)};
-    // std::cout << "\n\nChosen move:" << mc_moves_str[chosen_move] << '\n'
-    //<< "Orientations before move:" << state << '\n';
-    // std::cout << chosen_move << '\n';
-    switch (chosen_move) {
-      case mc_moves::swap_empty_full:
-        interactions.energy += attempt_swap_empty_full(
-            state, parameters, interactions, geometry, T);
-        break;
-      case mc_moves::swap_full_full:
-        interactions.energy += attempt_swap_full_full(
-            state, parameters, interactions, geometry, T);
-        break;
-      case mc_moves::rotate:
-        interactions.energy +=
-            attempt_rotate(state, parameters, interactions, geometry, T);
-        break;
-      case mc_moves::mutate:
-        interactions.energy +=
-            attempt_mutate(state, parameters, interactions, geometry, T);
-        break;
-      case mc_moves::rotate_and_swap_w_empty:
-        interactions.energy += attempt_rotate_and_swap_w_empty(
-            state, parameters, interactions, geometry, T);
-        break;
-      default:
-        throw std::runtime_error("Something went wrong in the move selection");
+    if (!is_move_possible(chosen_move, state)) {
+      continue;
     }
-    // std::cout << "Orientation after move:" << state << '\n';
+    interactions.energy += attempt_move(
+        chosen_move, state, parameters, interactions, geometry, T);
+    update_best_state(parameters, state, interactions, records);
+  }
+}
+
+void prefetch_next_proposals(state_struct& state,
+                             model_parameters_struct& parameters,
+                             geometry_space::Geometry& geometry)
+{
+  FullEmptySites& full_empty_sites {state.full_empty_sites};
+  if (full_empty_sites.get_n_full_sites() == 0) {
+    return;
+  }
+  // Drawing a position prefetches its entry of the list of full sites
+  while (full_empty_sites.get_n_full_sites_ahead() < n_proposals_ahead) {
+    full_empty_sites.draw_full_site_ahead(parameters);
+  }
+  const int n_neighbours {geometry.get_n_neighbours()};
+  const vec1i& neighbour_table {geometry.get_neighbour_table()};
+  // The site two proposals ahead is known: prefetch its neighbour indices,
+  // unless they are computed from the coordinates
+  int site {full_empty_sites.get_full_site_ahead(n_proposals_ahead - 2)};
+  if (!neighbour_table.empty()) {
+    array_space::prefetch_address(
+        &neighbour_table[static_cast<std::size_t>(site * n_neighbours)]);
+  }
+  // The neighbour indices of the next proposal are in cache: prefetch the
+  // states of its site and neighbours
+  site = full_empty_sites.get_full_site_ahead(n_proposals_ahead - 3);
+  state.lattice_sites.prefetch_site(site);
+  for (int bond {0}; bond < n_neighbours; ++bond) {
+    state.lattice_sites.prefetch_site(geometry.get_neighbour(site, bond));
+  }
+}
+
+double attempt_move(mc_moves chosen_move,
+                    state_struct& state,
+                    model_parameters_struct& parameters,
+                    interactions_struct& interactions,
+                    geometry_space::Geometry& geometry,
+                    double T)
+{
+  switch (chosen_move) {
+    case mc_moves::swap_empty_full:
+      return attempt_swap_empty_full(
+          state, parameters, interactions, geometry, T);
+    case mc_moves::swap_full_full:
+      return attempt_swap_full_full(
+          state, parameters, interactions, geometry, T);
+    case mc_moves::rotate:
+      return attempt_rotate(state, parameters, interactions, geometry, T);
+    case mc_moves::mutate:
+      return attempt_mutate(state, parameters, interactions, geometry, T);
+    case mc_moves::rotate_and_swap_w_empty:
+      return attempt_rotate_and_swap_w_empty(
+          state, parameters, interactions, geometry, T);
+    case mc_moves::heat_bath_rotate:
+      return attempt_heat_bath_rotate(
+          state, parameters, interactions, geometry, T);
+    case mc_moves::heat_bath_mutate:
+      return attempt_heat_bath_mutate(
+          state, parameters, interactions, geometry, T);
+    case mc_moves::insert_remove:
+      return attempt_insert_remove(
+          state, parameters, interactions, geometry, T);
+    default:
+      throw std::runtime_error("Something went wrong in the move selection");
   }
 }
 
@@ -62,6 +110,60 @@ mc_moves pick_random_move(model_parameters_struct& parameters)
   return static_cast<mc_moves>(move_index);
 }
 
+int pick_single_site_particle(state_struct& state,
+                              model_parameters_struct& parameters,
+                              interactions_struct& interactions)
+{
+  site_energy_field_struct& field {interactions.site_energy_field};
+  if (!field.option) {
+    return state.full_empty_sites.get_random_full_site(parameters);
+  }
+  real_dist proba_dist(0, 1);
+  return static_cast<int>(field.weights.sample(
+      proba_dist(parameters.rng) * field.weights.get_total_weight()));
+}
+
+double get_selection_log_ratio(state_struct& state,
+                               interactions_struct& interactions,
+                               geometry_space::Geometry& geometry,
+                               int site_index)
+{
+  site_energy_field_struct& field {interactions.site_energy_field};
+  if (!field.option) {
+    return 0.0;
+  }
+  get_changed_site_energies(state, interactions, geometry, site_index);
+  // The site and its neighbours change their weights, hence the total weight
+  double total_weight {field.weights.get_total_weight()};
+  double new_total_weight {total_weight};
+  for (std::size_t k {0}; k < field.changed_sites.size(); k++) {
+    int site {field.changed_sites[k]};
+    new_total_weight +=
+        get_site_weight(state, field, site, field.changed_energies[k])
+        - field.weights.get_weight(static_cast<std::size_t>(site));
+  }
+  // The picked site is the first changed site
+  double weight {field.weights.get_weight(static_cast<std::size_t>(site_index))};
+  double new_weight {
+      get_site_weight(state, field, site_index, field.changed_energies[0])};
+  return std::log(new_weight / new_total_weight)
+      - std::log(weight / total_weight);
+}
+
+bool is_move_possible(mc_moves chosen_move, state_struct& state)
+{
+  switch (chosen_move) {
+    case mc_moves::insert_remove:
+      return true;
+    case mc_moves::swap_empty_full:
+    case mc_moves::rotate_and_swap_w_empty:
+      return state.full_empty_sites.get_n_full_sites() > 0
+          and state.full_empty_sites.get_n_empty_sites() > 0;
+    default:
+      return state.full_empty_sites.get_n_full_sites() > 0;
+  }
+}
+
 // Function specifically to perform random rotations to avoid code reuse
 int perform_random_rotation(state_struct& state,
                             model_parameters_struct& parameters,
@@ -135,16 +237,19 @@ double attempt_swap_sites(int index1,
   // If the sites are neighbours, we need to avoid double counting
   // Make move and calculate energy after
   swap_sites(state, index1, index2);
+  set_umbrella_proposed_size(state, parameters, geometry, index1, index2);
   energy_change +=
       measure_pair_energy(index1, index2, bond, state, interactions, geometry);
   // std::cout << "Energy change is: " << energy_change << '\n' ;
   //  Accept or reject move
   if (is_move_accepted(energy_change, T, parameters)) {
     // std::cout << "Move accepted!\n" ;
+    update_site_energies(state, interactions, geometry, index1, index2);
     return energy_change;
   } else {
     // std::cout << "Move rejected :(\n";
     swap_sites(state, index1, index2);
+    update_umbrella_clusters(state, parameters, geometry, index1, index2);
     return 0.0;
   }
 }
@@ -155,6 +260,14 @@ double attempt_swap_empty_full(state_struct& state,
                                geometry_space::Geometry& geometry,
                                double T)
 {
+  // The weights of the candidates ignore the umbrella bias and the demon, so
+  // these fall back to a single destination
+  if (parameters.swap_empty_full_tries > 1 and !parameters.umbrella.option
+      and !parameters.demon.option)
+  {
+    return attempt_multiple_try_swap_empty_full(
+        state, parameters, interactions, geometry, T);
+  }
   int full_site_index {state.full_empty_sites.get_random_full_site(parameters)};
   int empty_site_index {
       state.full_empty_sites.get_random_empty_site(parameters)};
@@ -169,6 +282,95 @@ double attempt_swap_empty_full(state_struct& state,
                             T);
 }
 
+double attempt_multiple_try_swap_empty_full(state_struct& state,
+                                            model_parameters_struct& parameters,
+                                            interactions_struct& interactions,
+                                            geometry_space::Geometry& geometry,
+                                            double T)
+{
+  const std::size_t n_tries {
+      static_cast<std::size_t>(parameters.swap_empty_full_tries)};
+  vec1i& trial_sites {interactions.trial_sites};
+  vec1d& trial_energies {interactions.trial_energies};
+  trial_sites.resize(n_tries);
+
+  // Forward trials, drawn independently among the empty sites
+  int full_site_index {state.full_empty_sites.get_random_full_site(parameters)};
+  for (std::size_t j {0}; j < n_tries; j++) {
+    trial_sites[j] = state.full_empty_sites.get_random_empty_site(parameters);
+  }
+  get_trial_energies(full_site_index, n_tries, state, interactions, geometry);
+  int chosen {sample_heat_bath_state(
+      trial_energies, 0, static_cast<int>(n_tries), T, parameters)};
+  int empty_site_index {trial_sites[static_cast<std::size_t>(chosen)]};
+  double delta_e {trial_energies[static_cast<std::size_t>(chosen)]};
+  double log_forward_weight {get_log_trial_weight(trial_energies, n_tries, T)};
+
+  // Reverse trials from the new configuration: n_tries - 1 random empty sites
+  // and the original site, whose energy change is -delta_e
+  swap_sites(state, full_site_index, empty_site_index);
+  for (std::size_t j {0}; j + 1 < n_tries; j++) {
+    trial_sites[j] = state.full_empty_sites.get_random_empty_site(parameters);
+  }
+  get_trial_energies(
+      empty_site_index, n_tries - 1, state, interactions, geometry);
+  trial_energies[n_tries - 1] = -delta_e;
+  for (std::size_t j {0}; j < n_tries; j++) {
+    trial_energies[j] += delta_e;
+  }
+  double log_reverse_weight {get_log_trial_weight(trial_energies, n_tries, T)};
+
+  // The ratio of the weights, as an effective energy change
+  if (is_move_accepted(
+          -T * (log_forward_weight - log_reverse_weight), T, parameters))
+  {
+    update_site_energies(
+        state, interactions, geometry, full_site_index, empty_site_index);
+    return delta_e;
+  } else {
+    swap_sites(state, full_site_index, empty_site_index);
+    return 0.0;
+  }
+}
+
+void get_trial_energies(int full_site,
+                        std::size_t n_trials,
+                        state_struct& state,
+                        interactions_struct& interactions,
+                        geometry_space::Geometry& geometry)
+{
+  vec1i& trial_sites {interactions.trial_sites};
+  vec1d& trial_energies {interactions.trial_energies};
+  trial_energies.resize(trial_sites.size());
+  double initial_energy {
+      get_site_energy(state, interactions, geometry, full_site)};
+  // Only the lattice is swapped back and forth, the lists of full and empty
+  // sites are left untouched
+  for (std::size_t j {0}; j < n_trials; j++) {
+    state.lattice_sites.swap_sites(full_site, trial_sites[j]);
+    trial_energies[j] =
+        get_site_energy(state, interactions, geometry, trial_sites[j])
+        - initial_energy;
+    state.lattice_sites.swap_sites(full_site, trial_sites[j]);
+  }
+}
+
+double get_log_trial_weight(const vec1d& trial_energies,
+                            std::size_t n_trials,
+                            double T)
+{
+  // Shift by the lowest energy so that the weights cannot all underflow
+  double e_min {trial_energies[0]};
+  for (std::size_t j {0}; j < n_trials; j++) {
+    e_min = std::min(e_min, trial_energies[j]);
+  }
+  double total_weight {0.0};
+  for (std::size_t j {0}; j < n_trials; j++) {
+    total_weight += std::exp(-(trial_energies[j] - e_min) / T);
+  }
+  return std::log(total_weight) - e_min / T;
+}
+
 double attempt_swap_full_full(state_struct& state,
                               model_parameters_struct& parameters,
                               interactions_struct& interactions,
@@ -193,15 +395,25 @@ double attempt_rotate(state_struct& state,
                       geometry_space::Geometry& geometry,
                       double T)
 {
-  int site_index {state.full_empty_sites.get_random_full_site(parameters)};
-  double energy_change {
-      -get_site_energy(state, interactions, geometry, site_index)};
-
+  int site_index {pick_single_site_particle(state, parameters, interactions)};
   int old_orientation {perform_random_rotation(state, parameters, site_index)};
-  energy_change += get_site_energy(state, interactions, geometry, site_index);
+  double energy_change {get_site_change_energy(
+      state,
+      interactions,
+      geometry,
+      site_index,
+      old_orientation,
+      state.lattice_sites.get_type(site_index))};
+  double log_selection_ratio {
+      get_selection_log_ratio(state, interactions, geometry, site_index)};
   // std::cout << "Energy change is: " << energy_change << '\n' ;
-  if (is_move_accepted(energy_change, T, parameters)) {
+  if (is_move_accepted(
+          energy_change - T * log_selection_ratio, T, parameters))
+  {
     // std::cout << "Move accepted!\n";
+    if (interactions.site_energy_field.option) {
+      commit_site_energies(state, interactions);
+    }
     return energy_change;
   } else {
     // std::cout << "Move rejected!\n";
@@ -216,9 +428,7 @@ double attempt_mutate(state_struct& state,
                       geometry_space::Geometry& geometry,
                       double T)
 {
-  int site_index {state.full_empty_sites.get_random_full_site(parameters)};
-  double energy_change {
-      -get_site_energy(state, interactions, geometry, site_index)};
+  int site_index {pick_single_site_particle(state, parameters, interactions)};
 
   // Lower bound for orientation is 1, as orientation 0 corresponds
   // to an empty site
@@ -231,15 +441,30 @@ double attempt_mutate(state_struct& state,
   // std::cout << "Attempting rotation of site " << site_index
   //<< " with orientation " << old_orientation << " to "
   //<< new_orientation << '\n';
-  state.lattice_sites.set_type(site_index, new_type);
-  energy_change += get_site_energy(state, interactions, geometry, site_index);
+  set_particle_type(state, site_index, new_type);
+  double energy_change {get_site_change_energy(
+      state,
+      interactions,
+      geometry,
+      site_index,
+      state.lattice_sites.get_orientation(site_index),
+      old_type)};
   // std::cout << "Energy change is: " << energy_change << '\n' ;
-  if (is_move_accepted(energy_change, T, parameters)) {
+  double delta_mu {get_chemical_potential(parameters, new_type)
+                   - get_chemical_potential(parameters, old_type)};
+  double log_selection_ratio {
+      get_selection_log_ratio(state, interactions, geometry, site_index)};
+  if (is_move_accepted(
+          energy_change - delta_mu - T * log_selection_ratio, T, parameters))
+  {
     // std::cout << "Move accepted!\n";
+    if (interactions.site_energy_field.option) {
+      commit_site_energies(state, interactions);
+    }
     return energy_change;
   } else {
     // std::cout << "Move rejected!\n";
-    state.lattice_sites.set_type(site_index, old_type);
+    set_particle_type(state, site_index, old_type);
     return 0.0;
   }
 }
@@ -261,29 +486,312 @@ double attempt_rotate_and_swap_w_empty(state_struct& state,
   int old_orientation {
       perform_random_rotation(state, parameters, full_site_index)};
   swap_sites(state, full_site_index, empty_site_index);
+  set_umbrella_proposed_size(
+      state, parameters, geometry, full_site_index, empty_site_index);
 
   delta_e += measure_pair_energy(
       full_site_index, empty_site_index, bond, state, interactions, geometry);
 
   if (is_move_accepted(delta_e, T, parameters)) {
+    update_site_energies(
+        state, interactions, geometry, full_site_index, empty_site_index);
     return delta_e;
   } else {
     swap_sites(state, full_site_index, empty_site_index);
+    update_umbrella_clusters(
+        state, parameters, geometry, full_site_index, empty_site_index);
     state.lattice_sites.set_orientation(full_site_index, old_orientation);
     return 0.0;
   }
 }
 
+double attempt_heat_bath_rotate(state_struct& state,
+                                model_parameters_struct& parameters,
+                                interactions_struct& interactions,
+                                geometry_space::Geometry& geometry,
+                                double T)
+{
+  int site_index {state.full_empty_sites.get_random_full_site(parameters)};
+  vec1d& state_energies {interactions.site_state_energies};
+  get_site_state_energies(
+      state, interactions, geometry, site_index, state_energies);
+
+  int old_orientation {state.lattice_sites.get_orientation(site_index)};
+  int type {state.lattice_sites.get_type(site_index)};
+  int first_state {state.n_orientations * type};
+  int new_state {sample_heat_bath_state(
+      state_energies, first_state, state.n_orientations, T, parameters)};
+
+  state.lattice_sites.set_orientation(site_index, new_state - first_state);
+  parameters.n_accepted_moves += (new_state != first_state + old_orientation);
+  if (new_state != first_state + old_orientation) {
+    update_site_energies(state, interactions, geometry, site_index);
+  }
+  return state_energies[static_cast<std::size_t>(new_state)]
+      - state_energies[static_cast<std::size_t>(first_state + old_orientation)];
+}
+
+double attempt_heat_bath_mutate(state_struct& state,
+                                model_parameters_struct& parameters,
+                                interactions_struct& interactions,
+                                geometry_space::Geometry& geometry,
+                                double T)
+{
+  int site_index {state.full_empty_sites.get_random_full_site(parameters)};
+  vec1d& state_energies {interactions.site_state_energies};
+  get_site_state_energies(
+      state, interactions, geometry, site_index, state_energies);
+
+  int old_state {state.lattice_sites.get_orientation(site_index)
+                 + state.n_orientations
+                     * state.lattice_sites.get_type(site_index)};
+  // The types are drawn with their chemical potentials, which are taken back
+  // out of the energy change
+  for (int s {0}; s < state.n_states; s++) {
+    state_energies[static_cast<std::size_t>(s)] -=
+        get_chemical_potential(parameters, s / state.n_orientations);
+  }
+  int new_state {
+      sample_heat_bath_state(state_energies, 0, state.n_states, T, parameters)};
+  int new_type {new_state / state.n_orientations};
+  int old_type {old_state / state.n_orientations};
+
+  state.lattice_sites.set_orientation(site_index,
+                                      new_state % state.n_orientations);
+  set_particle_type(state, site_index, new_type);
+  parameters.n_accepted_moves += (new_state != old_state);
+  if (new_state != old_state) {
+    update_site_energies(state, interactions, geometry, site_index);
+  }
+  return state_energies[static_cast<std::size_t>(new_state)]
+      - state_energies[static_cast<std::size_t>(old_state)]
+      + get_chemical_potential(parameters, new_type)
+      - get_chemical_potential(parameters, old_type);
+}
+
+double get_chemical_potential(const model_parameters_struct& parameters,
+                              int type)
+{
+  if (parameters.move_probas[mc_moves::insert_remove] > 0) {
+    return parameters.chemical_potentials[static_cast<std::size_t>(type)];
+  }
+  return 0.0;
+}
+
+double attempt_insert_remove(state_struct& state,
+                             model_parameters_struct& parameters,
+                             interactions_struct& interactions,
+                             geometry_space::Geometry& geometry,
+                             double T)
+{
+  double n_full {static_cast<double>(state.full_empty_sites.get_n_full_sites())};
+  double n_empty {
+      static_cast<double>(state.full_empty_sites.get_n_empty_sites())};
+  double n_states {static_cast<double>(state.n_states)};
+  real_dist proba_dist(0, 1);
+
+  if (proba_dist(parameters.rng) < 0.5) {
+    if (n_empty == 0) {
+      return 0.0;
+    }
+    int site_index {state.full_empty_sites.get_random_empty_site(parameters)};
+    int_dist state_dist {0, state.n_states - 1};
+    int new_state {state_dist(parameters.rng)};
+    int type {new_state / state.n_orientations};
+    insert_particle(state, site_index, type, new_state % state.n_orientations);
+    set_umbrella_proposed_size(state, parameters, geometry, site_index);
+
+    double delta_e {get_site_energy(state, interactions, geometry, site_index)};
+    // Chemical potential and proposal ratio, as an effective energy change
+    double delta_omega {
+        delta_e - get_chemical_potential(parameters, type)
+        - T * std::log(n_empty * n_states / (n_full + 1))};
+    if (is_move_accepted(delta_omega, T, parameters)) {
+      update_site_energies(state, interactions, geometry, site_index);
+      return delta_e;
+    } else {
+      remove_particle(state, site_index);
+      update_umbrella_clusters(state, parameters, geometry, site_index);
+      return 0.0;
+    }
+  }
+
+  if (n_full == 0) {
+    return 0.0;
+  }
+  int site_index {state.full_empty_sites.get_random_full_site(parameters)};
+  int type {state.lattice_sites.get_type(site_index)};
+  int orientation {state.lattice_sites.get_orientation(site_index)};
+  double delta_e {-get_site_energy(state, interactions, geometry, site_index)};
+  remove_particle(state, site_index);
+  set_umbrella_proposed_size(state, parameters, geometry, site_index);
+
+  double delta_omega {
+      delta_e + get_chemical_potential(parameters, type)
+      - T * std::log(n_full / ((n_empty + 1) * n_states))};
+  if (is_move_accepted(delta_omega, T, parameters)) {
+    update_site_energies(state, interactions, geometry, site_index);
+    return delta_e;
+  } else {
+    insert_particle(state, site_index, type, orientation);
+    update_umbrella_clusters(state, parameters, geometry, site_index);
+    return 0.0;
+  }
+}
+
+int sample_heat_bath_state(const vec1d& state_energies,
+                           int first_state,
+                           int n_candidates,
+                           double T,
+                           model_parameters_struct& parameters)
+{
+  std::size_t first {static_cast<std::size_t>(first_state)};
+  std::size_t last {first + static_cast<std::size_t>(n_candidates)};
+  // Shift by the lowest energy so that the weights cannot underflow to zero
+  // all at once at low temperature
+  double e_min {state_energies[first]};
+  for (std::size_t i {first}; i < last; i++) {
+    e_min = std::min(e_min, state_energies[i]);
+  }
+  double total_weight {0.0};
+  for (std::size_t i {first}; i < last; i++) {
+    total_weight += std::exp(-(state_energies[i] - e_min) / T);
+  }
+  // Standard tower sampling algorithm
+  real_dist proba_dist(0, 1);
+  double sampled_weight {proba_dist(parameters.rng) * total_weight};
+  std::size_t i {first};
+  double cumulative_weight {std::exp(-(state_energies[i] - e_min) / T)};
+  while (cumulative_weight < sampled_weight and i + 1 < last) {
+    ++i;
+    cumulative_weight += std::exp(-(state_energies[i] - e_min) / T);
+  }
+  return static_cast<int>(i);
+}
+
 bool is_move_accepted(double delta_e,
                       double T,
                       model_parameters_struct& parameters)
 {
-  if (delta_e < 0) {
-    return true;
-  } else {
+  umbrella_struct& umbrella {parameters.umbrella};
+  if (umbrella.option and umbrella.proposed_size != umbrella.current_size) {
+    if (get_umbrella_window_distance(umbrella, umbrella.proposed_size)
+        > get_umbrella_window_distance(umbrella, umbrella.current_size))
+    {
+      umbrella.proposed_size = umbrella.current_size;
+      return false;
+    }
+    delta_e += get_umbrella_bias(umbrella, umbrella.proposed_size)
+        - get_umbrella_bias(umbrella, umbrella.current_size);
+  }
+
+  bool accepted {true};
+  if (parameters.demon.option) {
+    accepted = delta_e <= parameters.demon.energy;
+    if (accepted) {
+      parameters.demon.energy -= delta_e;
+    }
+  } else if (delta_e >= 0) {
     real_dist proba_dist(0, 1);
     double boltzmann_factor {std::exp(-delta_e / T)};
-    return boltzmann_factor > proba_dist(parameters.rng);
+    accepted = boltzmann_factor > proba_dist(parameters.rng);
+  }
+  parameters.n_accepted_moves += accepted;
+  if (accepted) {
+    umbrella.current_size = umbrella.proposed_size;
+  } else {
+    umbrella.proposed_size = umbrella.current_size;
+  }
+  return accepted;
+}
+
+double get_umbrella_bias(const umbrella_struct& umbrella, int n)
+{
+  double distance {n - umbrella.center};
+  return 0.5 * umbrella.spring * distance * distance;
+}
+
+int get_umbrella_window_distance(const umbrella_struct& umbrella, int n)
+{
+  if (n < umbrella.window_min) {
+    return umbrella.window_min - n;
+  } else if (n > umbrella.window_max) {
+    return n - umbrella.window_max;
+  }
+  return 0;
+}
+
+void initialize_umbrella_clusters(state_struct& state,
+                                  model_parameters_struct& parameters,
+                                  geometry_space::Geometry& geometry)
+{
+  if (!parameters.umbrella.option) {
+    return;
+  }
+  state.clusters = ClusterTracker(state, geometry);
+  parameters.umbrella.current_size = state.clusters.get_largest_cluster_size();
+  parameters.umbrella.proposed_size = parameters.umbrella.current_size;
+}
+
+void update_umbrella_clusters(state_struct& state,
+                              model_parameters_struct& parameters,
+                              geometry_space::Geometry& geometry,
+                              int site_1,
+                              int site_2)
+{
+  if (!parameters.umbrella.option
+      or state.lattice_sites.is_empty(site_1)
+          == state.lattice_sites.is_empty(site_2))
+  {
+    return;
+  }
+  // The emptied site leaves its cluster before the filled one joins
+  if (state.lattice_sites.is_empty(site_1)) {
+    state.clusters.update_after_removal(geometry, site_1);
+    state.clusters.update_after_insertion(geometry, site_2);
+  } else {
+    state.clusters.update_after_removal(geometry, site_2);
+    state.clusters.update_after_insertion(geometry, site_1);
+  }
+}
+
+void update_umbrella_clusters(state_struct& state,
+                              model_parameters_struct& parameters,
+                              geometry_space::Geometry& geometry,
+                              int site)
+{
+  if (!parameters.umbrella.option) {
+    return;
+  }
+  if (state.lattice_sites.is_empty(site)) {
+    state.clusters.update_after_removal(geometry, site);
+  } else {
+    state.clusters.update_after_insertion(geometry, site);
+  }
+}
+
+void set_umbrella_proposed_size(state_struct& state,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry,
+                                int site_1,
+                                int site_2)
+{
+  update_umbrella_clusters(state, parameters, geometry, site_1, site_2);
+  if (parameters.umbrella.option) {
+    parameters.umbrella.proposed_size =
+        state.clusters.get_largest_cluster_size();
+  }
+}
+
+void set_umbrella_proposed_size(state_struct& state,
+                                model_parameters_struct& parameters,
+                                geometry_space::Geometry& geometry,
+                                int site)
+{
+  update_umbrella_clusters(state, parameters, geometry, site);
+  if (parameters.umbrella.option) {
+    parameters.umbrella.proposed_size =
+        state.clusters.get_largest_cluster_size();
   }
 }
 
@@ -0,0 +1,81 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "fenwick_tree.h"
+
+#include <algorithm>
+
+namespace fenwick_space {
+
+void FenwickTree::assign(const vec1d& weights)
+{
+  weights_m = weights;
+  rebuild();
+}
+
+void FenwickTree::rebuild()
+{
+  tree_m = weights_m;
+  total_m = 0.0;
+  n_updates_m = 0;
+  const std::size_t n {tree_m.size()};
+  for (std::size_t k {1}; k <= n; k++) {
+    total_m += weights_m[k - 1];
+    std::size_t parent {k + (k & (~k + 1))};
+    if (parent <= n) {
+      tree_m[parent - 1] += tree_m[k - 1];
+    }
+  }
+}
+
+void FenwickTree::set_weight(std::size_t i, double weight)
+{
+  double delta {weight - weights_m[i]};
+  weights_m[i] = weight;
+  // The partial sums drift by rounding with every update, so they are
+  // recomputed from the weights after as many updates as there are weights
+  if (++n_updates_m >= weights_m.size()) {
+    rebuild();
+    return;
+  }
+  total_m += delta;
+  for (std::size_t k {i + 1}; k <= tree_m.size(); k += k & (~k + 1)) {
+    tree_m[k - 1] += delta;
+  }
+}
+
+std::size_t FenwickTree::sample(double u) const
+{
+  const std::size_t n {tree_m.size()};
+  std::size_t step {1};
+  while (2 * step <= n) {
+    step *= 2;
+  }
+  // Descend from the largest power of two, skipping every block whose sum is
+  // not larger than what remains of u
+  std::size_t position {0};
+  for (; step > 0; step /= 2) {
+    if (position + step <= n and tree_m[position + step - 1] <= u) {
+      position += step;
+      u -= tree_m[position - 1];
+    }
+  }
+  if (position < n and weights_m[position] > 0.0) {
+    return position;
+  }
+  // Rounding can push u past the last block, or onto an index of zero weight
+  // next to the end of a block: fall back to the nearest index of positive
+  // weight before it, or else to the first one
+  for (std::size_t k {std::min(position, n)}; k > 0; k--) {
+    if (weights_m[k - 1] > 0.0) {
+      return k - 1;
+    }
+  }
+  for (std::size_t k {0}; k < n; k++) {
+    if (weights_m[k] > 0.0) {
+      return k;
+    }
+  }
+  return 0;
+}
+}  // namespace fenwick_space
@@ -9,7 +9,7 @@ namespace io_space{
    * Routines for reading data from files
    */
 
-  void read_vector(vec1i &array, int N, std::string_view location){
+  void read_vector(vec1i &array, int N, std::string& location){
     std::ifstream array_f;
     std::string location_str {std::string(location)};
     array_f.open(location_str);
@@ -29,7 +29,7 @@ namespace io_space{
     array_f.close();
   }
 
-  void read_vector(vec1d &array, int N, std::string_view location){
+  void read_vector(vec1d &array, int N, std::string& location){
 
     std::ifstream array_f;
     std::string location_str {std::string(location)};
@@ -50,7 +50,7 @@ namespace io_space{
     array_f.close();
   }
 
-  void read_vector(vec2i &array, int N1, int N2, std::string_view location){
+  void read_vector(vec2i &array, int N1, int N2, std::string& location){
 
     std::ifstream array_f;
     std::string location_str {std::string(location)};
@@ -77,7 +77,7 @@ namespace io_space{
     array_f.close();
   }
 
-  void read_vector(vec2d &array, int N1, int N2, std::string_view location){
+  void read_vector(vec2d &array, int N1, int N2, std::string& location){
 
     std::ifstream array_f;
     std::string location_str {std::string(location)};
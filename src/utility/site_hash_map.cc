@@ -0,0 +1,132 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "site_hash_map.h"
+
+#include <algorithm>
+#include <cstdint>
+
+namespace site_hash_space {
+
+// Smallest number of slots of a non-empty table
+constexpr std::size_t min_n_slots {16};
+// 2^64 divided by the golden ratio
+constexpr uint64_t fibonacci_multiplier {0x9e3779b97f4a7c15};
+
+std::size_t SiteHashMap::get_home_slot(const int site) const
+{
+  // Fibonacci hashing: the top bits of the product by the multiplier
+  const uint64_t key {static_cast<uint64_t>(site)};
+  return static_cast<std::size_t>((key * fibonacci_multiplier) >> shift_m);
+}
+
+int SiteHashMap::get(const int site) const
+{
+  if (n_slots_m == 0) {
+    return -1;
+  }
+  const std::size_t mask {n_slots_m - 1};
+  for (std::size_t s {get_home_slot(site)};; s = (s + 1) & mask) {
+    const int slot_site {slots_m[2 * s]};
+    if (slot_site == site) {
+      return slots_m[2 * s + 1];
+    }
+    if (slot_site == -1) {
+      return -1;
+    }
+  }
+}
+
+void SiteHashMap::set(const int site, const int value)
+{
+  if (2 * (n_entries_m + 1) > n_slots_m) {
+    grow();
+  }
+  const std::size_t mask {n_slots_m - 1};
+  std::size_t s {get_home_slot(site)};
+  while (slots_m[2 * s] != -1 and slots_m[2 * s] != site) {
+    s = (s + 1) & mask;
+  }
+  if (slots_m[2 * s] == -1) {
+    slots_m[2 * s] = site;
+    n_entries_m++;
+  }
+  slots_m[2 * s + 1] = value;
+}
+
+void SiteHashMap::erase(const int site)
+{
+  if (n_slots_m == 0) {
+    return;
+  }
+  const std::size_t mask {n_slots_m - 1};
+  std::size_t hole {get_home_slot(site)};
+  while (slots_m[2 * hole] != site) {
+    if (slots_m[2 * hole] == -1) {
+      return;
+    }
+    hole = (hole + 1) & mask;
+  }
+  // Shift back the following entries of the probe run which may fill the
+  // hole: those whose home slot is not between the hole and themselves
+  for (std::size_t s {(hole + 1) & mask}; slots_m[2 * s] != -1;
+       s = (s + 1) & mask)
+  {
+    const std::size_t home {get_home_slot(slots_m[2 * s])};
+    if (((s - home) & mask) >= ((s - hole) & mask)) {
+      slots_m[2 * hole] = slots_m[2 * s];
+      slots_m[2 * hole + 1] = slots_m[2 * s + 1];
+      hole = s;
+    }
+  }
+  slots_m[2 * hole] = -1;
+  n_entries_m--;
+}
+
+void SiteHashMap::clear()
+{
+  slots_m.clear();
+  n_slots_m = 0;
+  n_entries_m = 0;
+  shift_m = 64;
+}
+
+vec1i SiteHashMap::get_sites() const
+{
+  vec1i sites {};
+  sites.reserve(n_entries_m);
+  for (std::size_t s {0}; s < n_slots_m; s++) {
+    if (slots_m[2 * s] != -1) {
+      sites.push_back(slots_m[2 * s]);
+    }
+  }
+  std::sort(sites.begin(), sites.end());
+  return sites;
+}
+
+void SiteHashMap::prefetch(const int site) const
+{
+  if (n_slots_m > 0) {
+    array_space::prefetch_address(&slots_m[2 * get_home_slot(site)]);
+  }
+}
+
+void SiteHashMap::grow()
+{
+  vec1i old_slots {};
+  old_slots.swap(slots_m);
+  n_slots_m = std::max(min_n_slots, 2 * n_slots_m);
+  shift_m = 64;
+  for (std::size_t n {n_slots_m}; n > 1; n /= 2) {
+    shift_m--;
+  }
+  slots_m.assign(2 * n_slots_m, -1);
+  n_entries_m = 0;
+  for (std::size_t s {0}; 2 * s < old_slots.size(); s++) {
+    if (old_slots[2 * s] != -1) {
+      set(old_slots[2 * s], old_slots[2 * s + 1]);
+    }
+  }
+}
+
+}  // namespace site_hash_space
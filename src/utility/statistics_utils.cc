@@ -0,0 +1,82 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "statistics_utils.h"
+
+#include <cmath>
+
+namespace statistics_space {
+
+std::size_t mser_truncation(const vec1d& series, std::size_t batch_size)
+{
+  if (batch_size == 0) {
+    batch_size = 1;
+  }
+  // Batch the series
+  std::size_t n {series.size() / batch_size};
+  if (n < 2) {
+    return 0;
+  }
+  vec1d batches(n, 0.0);
+  for (std::size_t i {0}; i < n * batch_size; i++) {
+    batches[i / batch_size] += series[i];
+  }
+  for (double& batch : batches) {
+    batch /= static_cast<double>(batch_size);
+  }
+
+  // Suffix sums give the mean and variance of every truncated series in O(n)
+  double sum {0.0};
+  double sum2 {0.0};
+  vec1d statistic(n, 0.0);
+  for (std::size_t d {n}; d-- > 0;) {
+    sum += batches[d];
+    sum2 += batches[d] * batches[d];
+    double n_kept {static_cast<double>(n - d)};
+    statistic[d] = (sum2 - sum * sum / n_kept) / (n_kept * n_kept);
+  }
+
+  // Truncations leaving fewer than 2 batches are meaningless
+  std::size_t best {0};
+  for (std::size_t d {1}; d + 1 < n; d++) {
+    if (statistic[d] < statistic[best]) {
+      best = d;
+    }
+  }
+  return best * batch_size;
+}
+
+bool is_equilibrated(const vec1d& series, std::size_t batch_size)
+{
+  if (series.size() < 4 * batch_size) {
+    return false;
+  }
+  return 2 * mser_truncation(series, batch_size) < series.size();
+}
+
+double batch_means_error(const vec1d& series,
+                         std::size_t n_batches,
+                         std::size_t first)
+{
+  if (n_batches < 2 or series.size() < first + 2 * n_batches) {
+    return -1.0;
+  }
+  std::size_t batch_size {(series.size() - first) / n_batches};
+  vec1d batches(n_batches, 0.0);
+  for (std::size_t i {0}; i < n_batches * batch_size; i++) {
+    batches[i / batch_size] += series[first + i];
+  }
+  double mean {0.0};
+  for (double& batch : batches) {
+    batch /= static_cast<double>(batch_size);
+    mean += batch;
+  }
+  mean /= static_cast<double>(n_batches);
+  double variance {0.0};
+  for (double batch : batches) {
+    variance += (batch - mean) * (batch - mean);
+  }
+  variance /= static_cast<double>(n_batches - 1);
+  return std::sqrt(variance / static_cast<double>(n_batches));
+}
+}  // namespace statistics_space
@@ -0,0 +1,88 @@
+// Copyright (c) 2024 Soft Biophysics Group LPTMS
+// Part of frusa_mc, released under BSD 3-Clause License.
+
+#include "thread_pool.h"
+
+namespace thread_space {
+
+ThreadPool::ThreadPool(int n_threads)
+{
+  if (n_threads <= 0) {
+    n_threads = static_cast<int>(std::thread::hardware_concurrency());
+  }
+  // hardware_concurrency is allowed to return 0 if it cannot tell
+  if (n_threads <= 0) {
+    n_threads = 1;
+  }
+  for (int i {0}; i < n_threads; i++) {
+    workers_m.emplace_back(&ThreadPool::worker_loop, this);
+  }
+}
+
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock {mutex_m};
+    stop_m = true;
+  }
+  batch_cv_m.notify_all();
+  for (std::thread& worker : workers_m) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallel_for(int n_tasks,
+                              const std::function<void(int)>& task)
+{
+  if (n_tasks <= 0) {
+    return;
+  }
+  std::unique_lock<std::mutex> lock {mutex_m};
+  task_m = &task;
+  n_tasks_m = n_tasks;
+  next_task_m = 0;
+  n_done_m = 0;
+  error_m = nullptr;
+  ++batch_id_m;
+  batch_cv_m.notify_all();
+  done_cv_m.wait(lock, [this] { return n_done_m == n_tasks_m; });
+  task_m = nullptr;
+  if (error_m) {
+    std::rethrow_exception(error_m);
+  }
+}
+
+void ThreadPool::worker_loop()
+{
+  long last_batch {0};
+  std::unique_lock<std::mutex> lock {mutex_m};
+  while (true) {
+    batch_cv_m.wait(lock, [this, last_batch] {
+      return stop_m or (batch_id_m != last_batch and task_m != nullptr);
+    });
+    if (stop_m) {
+      return;
+    }
+    last_batch = batch_id_m;
+    // Pull tasks until the batch is exhausted
+    while (next_task_m < n_tasks_m) {
+      int task_index {next_task_m++};
+      const std::function<void(int)>& task {*task_m};
+      lock.unlock();
+      std::exception_ptr error {};
+      try {
+        task(task_index);
+      } catch (...) {
+        error = std::current_exception();
+      }
+      lock.lock();
+      if (error and !error_m) {
+        error_m = error;
+      }
+      if (++n_done_m == n_tasks_m) {
+        done_cv_m.notify_one();
+      }
+    }
+  }
+}
+}  // namespace thread_space
@@ -0,0 +1,155 @@
+#! /usr/bin/env python3
+"""
+Compare the annealing of frusa_mc and frusa_mc_mpi on a 16x16 square lattice.
+
+Both executables anneal the same model, with couplings which do not depend on the
+orientations, so that the energy of a structure is simply e_contact times its number of
+occupied neighbouring pairs. The script checks that
+- the serial and MPI <E> agree at every temperature,
+- the energy tracked by the MPI run at the end of the schedule matches the energy
+  recomputed from the gathered final_structure.dat.
+
+Usage: python3 00_compare_serial_mpi.py [build_dir] [n_ranks]
+build_dir defaults to build/ at the root of the project, and has to be configured with
+-DMODEL_TYPE=lattice_particles -DFRUSA_MPI=ON.
+"""
+
+from pathlib import Path
+import subprocess
+import sys
+
+import numpy as np
+
+import config as cfg
+from contact_utils import ContactMapWrapper
+from json_dump import make_json_file
+
+lx = 16
+ly = 16
+n_particles = 100
+e_contact = -1.0
+
+# Tolerance on <E>, relative to the number of particles
+e_tolerance = 0.008 * n_particles
+
+
+def gen_params(run_path: Path):
+    model_params = {}
+    model_params["lattice_name"] = "square"
+    model_params["lx"] = lx
+    model_params["ly"] = ly
+    model_params["lz"] = 1
+    model_params["n_types"] = 1
+    model_params["n_particles"] = [n_particles]
+
+    cu = ContactMapWrapper.from_lattice_name("square", init_energy=e_contact)
+    model_params["couplings"] = cu.get_formatted_couplings()
+
+    model_params["initialize_option"] = "random"
+    model_params["state_av_option"] = False
+    model_params["e_av_option"] = True
+    model_params["e_record_option"] = False
+    model_params["e_av_output"] = str(run_path) + "/"
+
+    model_params["move_probas"] = {
+        "swap_empty_full": 1 / 4,
+        "rotate": 1 / 4,
+        "rotate_and_swap_w_empty": 1 / 4,
+        "swap_full_full": 1 / 4,
+    }
+
+    mc_params = {}
+    mc_params["mcs_eq"] = 2000
+    mc_params["mcs_av"] = 20000
+    mc_params["cooling_schedule"] = "linear"
+    mc_params["Ti"] = 2.5
+    mc_params["Tf"] = 1.5
+    mc_params["Nt"] = 3
+    mc_params["checkpoint_option"] = False
+    mc_params["final_structure_address"] = str(run_path) + "/"
+
+    make_json_file(model_params, run_path / "model_params.json")
+    make_json_file(mc_params, run_path / "mc_params.json")
+
+
+def get_energy(structure) -> float:
+    """Energy of a structure loaded with cfg.load_structure."""
+    occupied = (structure[1, :] != -1).reshape(ly, lx)
+    n_contacts = np.sum(occupied & np.roll(occupied, 1, axis=0)) + np.sum(
+        occupied & np.roll(occupied, 1, axis=1)
+    )
+    return e_contact * float(n_contacts)
+
+
+def run(command, run_path: Path) -> str:
+    result = subprocess.run(command, cwd=run_path, capture_output=True, text=True)
+    if result.returncode != 0:
+        print(result.stdout)
+        print(result.stderr)
+        sys.exit(f"{command[0]} failed")
+    return result.stdout
+
+
+def main():
+    build_path = Path(sys.argv[1]) if len(sys.argv) > 1 else cfg.parent_path / "build"
+    n_ranks = sys.argv[2] if len(sys.argv) > 2 else "2"
+    build_path = build_path.resolve()
+
+    serial_path = Path("./data/serial").resolve()
+    mpi_path = Path("./data/mpi").resolve()
+    for run_path in (serial_path, mpi_path):
+        run_path.mkdir(parents=True, exist_ok=True)
+        gen_params(run_path)
+        # Serial averages are written to one file per temperature
+        for old_file in run_path.glob("esf_av_T_*.dat"):
+            old_file.unlink()
+
+    run(
+        [str(build_path / "app/frusa_mc"), "-m", "model_params.json",
+         "-M", "mc_params.json"],
+        serial_path,
+    )
+    mpi_output = run(
+        ["mpirun", "-np", n_ranks, str(build_path / "app/frusa_mc_mpi"),
+         "-m", "model_params.json", "-M", "mc_params.json"],
+        mpi_path,
+    )
+
+    serial_energies = np.array(
+        sorted(
+            (np.loadtxt(f) for f in serial_path.glob("esf_av_T_*.dat")),
+            key=lambda line: -line[0],
+        )
+    )
+    mpi_energies = np.loadtxt(mpi_path / "mpi_energies.dat", ndmin=2)
+
+    passed = True
+    print("     T   serial <E>   MPI <E>")
+    for serial_line, mpi_line in zip(serial_energies, mpi_energies):
+        print(f"{serial_line[0]:6.3f} {serial_line[1]:12.4f} {mpi_line[1]:9.4f}")
+        if abs(serial_line[1] - mpi_line[1]) > e_tolerance:
+            print(f"<E> differs by more than {e_tolerance} at T = {serial_line[0]}")
+            passed = False
+    if len(serial_energies) != len(mpi_energies):
+        print("The serial and MPI runs did not visit the same temperatures")
+        passed = False
+
+    # Energy printed by rank 0 at the end of the last temperature step
+    tracked_energy = float(
+        [line for line in mpi_output.splitlines() if line.startswith("Energy at T")][-1]
+        .split(":")[-1]
+    )
+    final_energy = get_energy(
+        cfg.load_structure(struct_file=mpi_path / "final_structure.dat")
+    )
+    print(f"Tracked final energy {tracked_energy}, recomputed {final_energy}")
+    if abs(tracked_energy - final_energy) > 1e-6:
+        passed = False
+
+    if not passed:
+        sys.exit("Serial and MPI runs disagree")
+    print("Serial and MPI runs agree")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,163 @@
+#! /usr/bin/env python3
+"""
+Check the transfer_matrix simulation mode on a chain.
+
+The free energy, <E> and density written to transfer_matrix.dat are compared with the
+largest eigenvalue of the transfer matrix of the chain, built here from the face energies,
+and <E> with an annealing of a 100-site chain at the same temperatures. The chain is either
+full, with a single type and no chemical potential, or grand-canonical.
+
+Usage: python3 transfer_matrix.py [frusa_mc executable]
+"""
+
+from pathlib import Path
+from subprocess import run
+import sys
+
+import numpy as np
+
+import config as cfg
+import contact_utils as cu
+from json_dump import make_json_file
+
+e_11 = -1.0
+e_22 = 0.0
+e_12 = 0.5
+mu = -0.5
+
+lx = 100
+temperatures = [3.0, 2.5, 2.0, 1.5, 1.0, 0.5]
+
+# Tolerance on the exact results, written with 8 significant digits, and on the MC <E>
+# per site
+exact_tolerance = 1e-6
+mc_tolerance = 0.005
+
+
+def get_exact_results(T, grand_canonical):
+    """
+    Free energy, <E> and density per site of the infinite chain from the eigenvalues of
+    its transfer matrix. The couplings are symmetrised, so that the contact between two
+    particles costs e_12 when they are parallel and (e_11 + e_22) / 2 otherwise.
+    """
+    e_antiparallel = (e_11 + e_22) / 2
+
+    def get_log_eigenvalue(beta, chemical_potential):
+        contacts = np.array([[e_12, e_antiparallel], [e_antiparallel, e_12]])
+        if grand_canonical:
+            # Empty site first, half of the chemical potential of a site on each bond
+            energies = np.zeros((3, 3))
+            energies[1:, 1:] = contacts
+            particles = np.array([0.0, 1.0, 1.0])
+            energies -= chemical_potential * (particles[:, None] + particles[None, :]) / 2
+        else:
+            energies = contacts
+        return np.log(np.max(np.linalg.eigvalsh(np.exp(-beta * energies))))
+
+    beta = 1 / T
+    h = 1e-5
+    free_energy = -T * get_log_eigenvalue(beta, mu)
+    # The derivatives of the log of the eigenvalue with beta and mu give <E - mu N> and
+    # beta <N> per site
+    grand_energy = -(get_log_eigenvalue(beta + h, mu) - get_log_eigenvalue(beta - h, mu)) / (
+        2 * h
+    )
+    if not grand_canonical:
+        return free_energy, grand_energy, 1.0
+    density = T * (get_log_eigenvalue(beta, mu + h) - get_log_eigenvalue(beta, mu - h)) / (2 * h)
+    return free_energy, grand_energy + mu * density, density
+
+
+def gen_params(run_path: Path, grand_canonical, simulation_mode):
+    model_params = {}
+    model_params["lattice_name"] = "chain"
+    model_params["lx"] = lx
+    model_params["ly"] = 1
+    model_params["lz"] = 1
+    model_params["n_types"] = 1
+    model_params["n_particles"] = [lx // 2 if grand_canonical else lx]
+    model_params["couplings"] = cu.flatten_couplings(cu.chain_LEL_1type(e_11, e_22, e_12))
+    model_params["initialize_option"] = "random"
+    model_params["state_av_option"] = False
+    model_params["e_av_option"] = True
+    model_params["e_record_option"] = False
+    model_params["e_av_output"] = str(run_path) + "/"
+
+    moves_dict = {}
+    if grand_canonical:
+        model_params["chemical_potentials"] = [mu]
+        moves_dict["insert_remove"] = 1 / 3
+        moves_dict["swap_empty_full"] = 1 / 3
+        moves_dict["rotate"] = 1 / 3
+    else:
+        moves_dict["rotate"] = 1
+    model_params["move_probas"] = moves_dict
+
+    mc_params = {}
+    mc_params["mcs_eq"] = 2000
+    mc_params["mcs_av"] = 20000
+    mc_params["cooling_schedule"] = "linear"
+    mc_params["Ti"] = temperatures[0]
+    mc_params["Tf"] = temperatures[-1]
+    mc_params["Nt"] = len(temperatures)
+    mc_params["checkpoint_option"] = False
+    mc_params["final_structure_address"] = str(run_path) + "/"
+    mc_params["simulation_mode"] = simulation_mode
+
+    make_json_file(model_params, run_path / "model_params.json")
+    make_json_file(mc_params, run_path / "mc_params.json")
+
+
+def check_chain(exec_path, grand_canonical):
+    name = "grand_canonical" if grand_canonical else "full"
+    print(f"--- {name} chain ---")
+    results = {}
+    for simulation_mode in ("transfer_matrix", "annealing"):
+        run_path = Path(f"./data/transfer_matrix/{name}_{simulation_mode}").resolve()
+        run_path.mkdir(parents=True, exist_ok=True)
+        for old_file in run_path.glob("esf_av_T_*.dat"):
+            old_file.unlink()
+        gen_params(run_path, grand_canonical, simulation_mode)
+        process = run(
+            [str(exec_path), "-m", "model_params.json", "-M", "mc_params.json"],
+            cwd=run_path,
+            capture_output=True,
+        )
+        if process.returncode != 0:
+            sys.exit(f"The {simulation_mode} run failed")
+        results[simulation_mode] = run_path
+
+    tm_lines = np.loadtxt(results["transfer_matrix"] / "transfer_matrix.dat", ndmin=2)
+    mc_energies = {
+        round(line[0], 6): line[1] / lx
+        for line in (
+            np.loadtxt(f) for f in results["annealing"].glob("esf_av_T_*.dat")
+        )
+    }
+
+    passed = True
+    print("     T    free energy       <E>  exact <E>     MC <E>   density")
+    for line in tm_lines:
+        T, free_energy, energy, density = line[0], line[1], line[2], line[4]
+        exact = get_exact_results(T, grand_canonical)
+        mc_energy = mc_energies[round(T, 6)]
+        print(
+            f"{T:6.3f} {free_energy:14.8f} {energy:9.5f} {exact[1]:10.5f}"
+            f" {mc_energy:10.5f} {density:9.5f}"
+        )
+        if np.max(np.abs(np.array([free_energy, energy, density]) - exact)) > exact_tolerance:
+            print(f"The transfer matrix does not match the exact results at T = {T}")
+            passed = False
+        if abs(energy - mc_energy) > mc_tolerance:
+            print(f"The transfer matrix does not match the MC <E> at T = {T}")
+            passed = False
+    return passed
+
+
+if __name__ == "__main__":
+    exec_path = Path(sys.argv[1]) if len(sys.argv) > 1 else cfg.exec_path
+    passed = check_chain(exec_path, grand_canonical=False)
+    passed = check_chain(exec_path, grand_canonical=True) and passed
+    if not passed:
+        sys.exit("The transfer matrix is wrong")
+    print("The transfer matrix matches the exact and MC results")